@@ -0,0 +1,49 @@
+#include "dedup_window.h"
+#include <string.h>
+
+#define BIT_WORD(id) (((id) % DEDUP_WINDOW_BITS) / 32)
+#define BIT_MASK(id) (1u << ((id) % 32))
+
+void dedup_window_init(dedup_window_t *window) {
+    memset(window, 0, sizeof(dedup_window_t));
+}
+
+bool dedup_window_check_and_set(dedup_window_t *window, uint32_t msg_id) {
+    if (!window->initialized) {
+        memset(window->bitmap, 0, sizeof(window->bitmap));
+        window->highest = msg_id;
+        window->bitmap[BIT_WORD(msg_id)] |= BIT_MASK(msg_id);
+        window->initialized = true;
+        return true;
+    }
+
+    int32_t advance = (int32_t)(msg_id - window->highest);
+    if (advance > 0) {
+        // 窗口前移, 清除被新 ID 复用的位
+        if (advance >= DEDUP_WINDOW_BITS) {
+            memset(window->bitmap, 0, sizeof(window->bitmap));
+        } else {
+            for (uint32_t id = window->highest + 1; id != msg_id; id++) {
+                window->bitmap[BIT_WORD(id)] &= ~BIT_MASK(id);
+            }
+        }
+        window->highest = msg_id;
+        window->bitmap[BIT_WORD(msg_id)] |= BIT_MASK(msg_id);
+        return true;
+    }
+
+    // 早于窗口的消息无法判断: msg_id 由所有主题共用, 延迟队列或退避中的重传很容易
+    // 落后窗口, 丢弃会让从未送达的消息丢失, 因此照常分发并单独计数
+    if ((uint32_t)(-advance) >= DEDUP_WINDOW_BITS) {
+        window->stale++;
+        return true;
+    }
+
+    if (window->bitmap[BIT_WORD(msg_id)] & BIT_MASK(msg_id)) {
+        window->duplicates++;
+        return false;
+    }
+
+    window->bitmap[BIT_WORD(msg_id)] |= BIT_MASK(msg_id);
+    return true;
+}
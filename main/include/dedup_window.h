@@ -0,0 +1,25 @@
+#ifndef DEDUP_WINDOW_H
+#define DEDUP_WINDOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 滑动窗口去重: 用位图记录最近 DEDUP_WINDOW_BITS 个 msg_id 是否已见
+// 内存固定, 查找和插入为 O(1) (窗口前移时按前移距离清位, 均摊 O(1))
+#define DEDUP_WINDOW_BITS 256
+#define DEDUP_WINDOW_WORDS (DEDUP_WINDOW_BITS / 32)
+
+typedef struct {
+    uint32_t highest;                      // 已见过的最大 msg_id
+    uint32_t bitmap[DEDUP_WINDOW_WORDS];   // 第 (id % BITS) 位表示 id 是否已见
+    uint32_t duplicates;                   // 被判定为重复的消息数
+    uint32_t stale;                        // 早于窗口、无法判断而照常分发的消息数
+    bool initialized;
+} dedup_window_t;
+
+void dedup_window_init(dedup_window_t *window);
+// 首次出现返回 true 并记录; 重复返回 false
+// 早于窗口的 msg_id 无法判断是否见过, 返回 true 并计入 stale (可能重复分发, 但不丢消息)
+bool dedup_window_check_and_set(dedup_window_t *window, uint32_t msg_id);
+
+#endif /* DEDUP_WINDOW_H */
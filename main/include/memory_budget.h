@@ -0,0 +1,39 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "pubsub_core.h"
+
+// 消息内存预算: 在发布时按优先级做准入控制
+//   used + size <= soft_watermark             所有优先级
+//   used + size <= total - critical_reserve   NORMAL/HIGH
+//   used + size <= total                      仅 CRITICAL
+// 每个主题另有字节上限, CRITICAL 消息不受主题上限约束
+// size 传入载荷长度, 按内存池中的实际占用 (含块头和对齐) 计入, 统计中的字节数同样是实际占用
+typedef struct {
+    size_t total_bytes;              // 全局预算 (0 = 内存池总大小)
+    uint8_t soft_watermark_pct;      // 软水位线, 占 (total - reserve) 的百分比
+    size_t critical_reserve_bytes;   // 为 CRITICAL 消息保留的字节数
+    size_t per_topic_limit_bytes;    // 每个主题的默认上限 (0 = 不限制)
+} memory_budget_config_t;
+
+// 主题预算统计
+typedef struct {
+    size_t used_bytes;
+    size_t peak_bytes;
+    size_t limit_bytes;
+    uint32_t shed_count[MSG_PRIORITY_CRITICAL + 1];  // 按优先级统计被丢弃的消息
+} memory_budget_topic_stats_t;
+
+// 内存预算API
+esp_err_t memory_budget_init(const memory_budget_config_t *config);
+bool memory_budget_admit(uint32_t topic_index, size_t size, msg_priority_t priority);
+void memory_budget_release(uint32_t topic_index, size_t size);
+esp_err_t memory_budget_set_topic_limit(uint32_t topic_index, size_t limit_bytes);
+esp_err_t memory_budget_get_topic_stats(uint32_t topic_index, memory_budget_topic_stats_t *stats);
+void memory_budget_get_usage(size_t *used, size_t *soft_watermark, size_t *total);
+
+#endif /* MEMORY_BUDGET_H */
@@ -2,18 +2,59 @@
 #define MEMORY_POOL_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 // 内存块大小定义
 #define MEMORY_BLOCK_SIZE 128
 #define MEMORY_POOL_BLOCKS 100
 
+// 定义 MEMORY_POOL_PROFILING 启用分配剖析 (调用点统计、直方图、泄漏转储)
+// #define MEMORY_POOL_PROFILING
+#define MEMORY_POOL_HISTOGRAM_BUCKETS 8   // <=16, <=32, ... <=1024, >1024
+#define MEMORY_POOL_MAX_CALLSITES 32
+
 typedef struct memory_pool_t memory_pool_t;
 
+// 碎片统计信息
+typedef struct {
+    size_t free_bytes;             // 空闲字节总数
+    size_t largest_free_block;     // 最大空闲块
+    uint32_t free_block_count;     // 空闲块数量
+    uint32_t used_block_count;     // 已分配块数量
+    uint32_t alloc_failures;       // 分配失败次数
+} memory_pool_frag_stats_t;
+
+// 调用点统计
+typedef struct {
+    const char *file;
+    int line;
+    uint32_t live_count;           // 当前存活的分配数
+    size_t live_bytes;             // 当前存活的字节数
+    uint32_t total_count;          // 累计分配次数
+} memory_pool_callsite_t;
+
 // 内存池API
 esp_err_t memory_pool_init(void);
-void *memory_pool_alloc(size_t size);
 void memory_pool_free(void *ptr);
 void memory_pool_stats(size_t *total, size_t *used, size_t *peak);
+void memory_pool_get_frag_stats(memory_pool_frag_stats_t *stats);
+// 分配 size 字节在池中实际占用的字节数 (含块头和对齐), size 为 0 时返回 0
+size_t memory_pool_block_footprint(size_t size);
+
+#ifdef MEMORY_POOL_PROFILING
+void *memory_pool_alloc_trace(size_t size, const char *file, int line);
+#define memory_pool_alloc(size) memory_pool_alloc_trace((size), __FILE__, __LINE__)
+
+// histogram[i] 为当前存活且大小落在第 i 个桶内的分配数
+void memory_pool_get_histogram(uint32_t histogram[MEMORY_POOL_HISTOGRAM_BUCKETS]);
+// 返回写入的调用点数量
+int memory_pool_get_callsites(memory_pool_callsite_t *sites, int max_sites);
+// 打印所有存活的分配及其调用点
+void memory_pool_dump_leaks(void);
+#else
+void *memory_pool_alloc(size_t size);
+#endif
 
-#endif /* MEMORY_POOL_H */ 
\ No newline at end of file
+#endif /* MEMORY_POOL_H */
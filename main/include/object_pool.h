@@ -0,0 +1,89 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+// 定长对象池: 编译期确定容量, 空闲对象通过侵入式单链表串联
+// 用法:
+//   OBJECT_POOL_DEFINE(subscriber_pool, subscriber_t, 64)
+//   subscriber_pool_init();
+//   subscriber_t *s = subscriber_pool_alloc();
+//   subscriber_pool_free(s);
+// 分配/释放均为 O(1), 仅在自旋锁临界区内操作两个指针
+
+// 对象池统计信息
+typedef struct {
+    uint32_t capacity;
+    uint32_t in_use;
+    uint32_t peak;
+    uint32_t alloc_failures;
+} object_pool_stats_t;
+
+#define OBJECT_POOL_DEFINE(name, type, pool_capacity)                               \
+    typedef union name##_slot {                                                     \
+        type object;                                                                \
+        union name##_slot *next_free;                                               \
+    } name##_slot_t;                                                                \
+                                                                                    \
+    static struct {                                                                 \
+        name##_slot_t slots[pool_capacity];                                         \
+        name##_slot_t *free_list;                                                   \
+        object_pool_stats_t stats;                                                  \
+        portMUX_TYPE mux;                                                           \
+    } name = { .mux = portMUX_INITIALIZER_UNLOCKED };                               \
+                                                                                    \
+    static __attribute__((unused)) void name##_init(void) {                         \
+        portENTER_CRITICAL(&name.mux);                                              \
+        for (uint32_t i = 0; i < (pool_capacity) - 1; i++) {                        \
+            name.slots[i].next_free = &name.slots[i + 1];                           \
+        }                                                                           \
+        name.slots[(pool_capacity) - 1].next_free = NULL;                           \
+        name.free_list = &name.slots[0];                                            \
+        memset(&name.stats, 0, sizeof(object_pool_stats_t));                        \
+        name.stats.capacity = (pool_capacity);                                      \
+        portEXIT_CRITICAL(&name.mux);                                               \
+    }                                                                               \
+                                                                                    \
+    static __attribute__((unused)) type *name##_alloc(void) {                       \
+        portENTER_CRITICAL(&name.mux);                                              \
+        name##_slot_t *slot = name.free_list;                                       \
+        if (slot == NULL) {                                                         \
+            name.stats.alloc_failures++;                                            \
+            portEXIT_CRITICAL(&name.mux);                                           \
+            return NULL;                                                            \
+        }                                                                           \
+        name.free_list = slot->next_free;                                           \
+        if (++name.stats.in_use > name.stats.peak) {                                \
+            name.stats.peak = name.stats.in_use;                                    \
+        }                                                                           \
+        portEXIT_CRITICAL(&name.mux);                                               \
+        return &slot->object;                                                       \
+    }                                                                               \
+                                                                                    \
+    static __attribute__((unused)) bool name##_owns(const type *object) {           \
+        const name##_slot_t *slot = (const name##_slot_t *)object;                  \
+        return slot >= &name.slots[0] && slot < &name.slots[pool_capacity];         \
+    }                                                                               \
+                                                                                    \
+    static __attribute__((unused)) void name##_free(type *object) {                 \
+        if (object == NULL || !name##_owns(object)) {                               \
+            return;                                                                 \
+        }                                                                           \
+        name##_slot_t *slot = (name##_slot_t *)object;                              \
+        portENTER_CRITICAL(&name.mux);                                              \
+        slot->next_free = name.free_list;                                           \
+        name.free_list = slot;                                                      \
+        name.stats.in_use--;                                                        \
+        portEXIT_CRITICAL(&name.mux);                                               \
+    }                                                                               \
+                                                                                    \
+    static __attribute__((unused)) void name##_get_stats(object_pool_stats_t *stats) { \
+        portENTER_CRITICAL(&name.mux);                                              \
+        *stats = name.stats;                                                        \
+        portEXIT_CRITICAL(&name.mux);                                               \
+    }
+
+#endif /* OBJECT_POOL_H */
@@ -15,6 +15,7 @@
 #define MAX_SUBSCRIBERS_PER_TOPIC 20
 #define MAX_MSG_SIZE 1024
 #define MAX_QUEUE_SIZE 100
+#define MAX_SUBSCRIBERS_TOTAL 128
 
 // 消息优先级定义
 typedef enum {
@@ -31,6 +32,7 @@ typedef struct {
     uint32_t data_len;
     msg_priority_t priority;
     uint64_t timestamp;
+    uint32_t msg_id;               // 由 message_handler 分配的消息ID, 0 表示未跟踪
     void *user_data;
 } pubsub_msg_t;
 
@@ -45,7 +47,8 @@ typedef enum {
     PUBSUB_ERR_TOPIC_EXISTS,
     PUBSUB_ERR_TOPIC_NOT_FOUND,
     PUBSUB_ERR_QUEUE_FULL,
-    PUBSUB_ERR_MAX_SUBSCRIBERS
+    PUBSUB_ERR_MAX_SUBSCRIBERS,
+    PUBSUB_ERR_OVER_BUDGET
 } pubsub_err_t;
 
 // 主要API函数声明
@@ -56,5 +59,17 @@ pubsub_err_t pubsub_delete_topic(const char *topic_name);
 pubsub_err_t pubsub_subscribe(const char *topic_name, subscriber_callback_t callback, void *user_data);
 pubsub_err_t pubsub_unsubscribe(const char *topic_name, subscriber_callback_t callback);
 pubsub_err_t pubsub_publish(const char *topic_name, const uint8_t *data, uint32_t data_len, msg_priority_t priority);
+pubsub_err_t pubsub_publish_with_id(const char *topic_name, const uint8_t *data, uint32_t data_len,
+                                    msg_priority_t priority, uint32_t msg_id);
+// 转移所有权的发布: data 必须由 memory_pool_alloc 分配, 成功后由主题任务释放, 失败时仍归调用者
+// 主题队列满时最多等待 wait_ticks, 让调用者 (如网络接收任务) 承受背压
+pubsub_err_t pubsub_publish_owned(const char *topic_name, uint8_t *data, uint32_t data_len,
+                                  msg_priority_t priority, TickType_t wait_ticks);
+pubsub_err_t pubsub_publish_owned_with_id(const char *topic_name, uint8_t *data, uint32_t data_len,
+                                          msg_priority_t priority, uint32_t msg_id,
+                                          TickType_t wait_ticks);
+pubsub_err_t pubsub_set_topic_dedup(const char *topic_name, bool enable);
+// 主题在主题表中的位置 (也是内存预算的主题索引), 主题只增不删, 位置不会变化; 不存在返回 -1
+int pubsub_get_topic_index(const char *topic_name);
 
 #endif /* PUBSUB_CORE_H */ 
\ No newline at end of file
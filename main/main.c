@@ -5,6 +5,9 @@
 #include "nvs_flash.h"
 #include "pubsub_core.h"
 #include "network_layer.h"
+#include "mqtt_bridge.h"
+#include "mqtt_forwarder.h"
+#include "offline_store.h"
 #include "error_handler.h"
 
 #define TAG "MAIN"
@@ -59,6 +62,30 @@ void app_main(void) {
     // 初始化发布-订阅系统
     ESP_ERROR_CHECK(pubsub_init());
 
+    // 入站桥接: 服务端下发的控制命令注入本地主题, 本地队列满时最多阻塞接收 100ms
+    mqtt_bridge_config_t bridge_config = {
+        .block_ticks = pdMS_TO_TICKS(100)
+    };
+    ESP_ERROR_CHECK(mqtt_bridge_init(&bridge_config));
+    mqtt_bridge_route_t led_route = {
+        .remote_filter = "devices/esp32_device_001/control/led",
+        .local_topic = "control/led",
+        .qos = 1,
+        .priority = MSG_PRIORITY_HIGH
+    };
+    ESP_ERROR_CHECK(mqtt_bridge_add_route(&led_route));
+
+    // 离线存储: 断网期间的上行消息写入 "offline" 数据分区, 重连后每秒最多补发 20 条
+    offline_store_config_t store_config = {
+        .partition_label = "offline",
+        .send = network_publish_direct,
+        .drain_rate_per_sec = 20,
+        .flush_interval_ms = 1000
+    };
+    if (offline_store_init(&store_config) != ESP_OK) {
+        ESP_LOGW(TAG, "Offline store unavailable, messages are dropped while disconnected");
+    }
+
     // 配置网络
     network_config_t network_config = {
         .wifi_ssid = "YourWiFiSSID",
@@ -79,6 +106,18 @@ void app_main(void) {
     ESP_ERROR_CHECK(pubsub_create_topic("sensor/humidity"));
     ESP_ERROR_CHECK(pubsub_create_topic("control/led"));
 
+    // 出站转发: 温度最多每秒上报 1 次, 攒 500ms 后一起发送
+    ESP_ERROR_CHECK(mqtt_forwarder_init(NULL));
+    mqtt_forwarder_route_t temperature_route = {
+        .local_topic = "sensor/temperature",
+        .remote_topic = "devices/esp32_device_001/sensor/temperature",
+        .qos = 1,
+        .rate_per_sec = 1,
+        .burst = 5,
+        .batch_window_ms = 500
+    };
+    ESP_ERROR_CHECK(mqtt_forwarder_add_route(&temperature_route));
+
     // 订阅主题
     ESP_ERROR_CHECK(pubsub_subscribe("sensor/temperature", message_callback, NULL));
     ESP_ERROR_CHECK(pubsub_subscribe("sensor/humidity", message_callback, NULL));
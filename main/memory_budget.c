@@ -0,0 +1,141 @@
+#include "memory_budget.h"
+#include "memory_pool.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+#define DEFAULT_SOFT_WATERMARK_PCT 70
+#define DEFAULT_CRITICAL_RESERVE (MEMORY_POOL_BLOCKS * MEMORY_BLOCK_SIZE / 10)
+
+typedef struct {
+    size_t used_bytes;
+    size_t peak_bytes;
+    size_t limit_bytes;
+    uint32_t shed_count[MSG_PRIORITY_CRITICAL + 1];
+} topic_budget_t;
+
+static struct {
+    memory_budget_config_t config;
+    size_t soft_watermark;
+    size_t hard_watermark;
+    size_t used_bytes;
+    topic_budget_t topics[MAX_TOPICS];
+    portMUX_TYPE mux;
+} budget_ctx = { .mux = portMUX_INITIALIZER_UNLOCKED };
+
+esp_err_t memory_budget_init(const memory_budget_config_t *config) {
+    memory_budget_config_t cfg = {
+        .total_bytes = MEMORY_POOL_BLOCKS * MEMORY_BLOCK_SIZE,
+        .soft_watermark_pct = DEFAULT_SOFT_WATERMARK_PCT,
+        .critical_reserve_bytes = DEFAULT_CRITICAL_RESERVE,
+        .per_topic_limit_bytes = 0
+    };
+    if (config != NULL) {
+        memcpy(&cfg, config, sizeof(memory_budget_config_t));
+        if (cfg.total_bytes == 0) {
+            cfg.total_bytes = MEMORY_POOL_BLOCKS * MEMORY_BLOCK_SIZE;
+        }
+    }
+
+    if (cfg.soft_watermark_pct > 100 || cfg.critical_reserve_bytes >= cfg.total_bytes) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&budget_ctx.mux);
+    memcpy(&budget_ctx.config, &cfg, sizeof(memory_budget_config_t));
+    budget_ctx.hard_watermark = cfg.total_bytes - cfg.critical_reserve_bytes;
+    budget_ctx.soft_watermark = budget_ctx.hard_watermark * cfg.soft_watermark_pct / 100;
+    // 重新配置时保留当前用量, 只更新上限
+    for (int i = 0; i < MAX_TOPICS; i++) {
+        budget_ctx.topics[i].limit_bytes = cfg.per_topic_limit_bytes;
+    }
+    portEXIT_CRITICAL(&budget_ctx.mux);
+
+    return ESP_OK;
+}
+
+bool memory_budget_admit(uint32_t topic_index, size_t size, msg_priority_t priority) {
+    if (topic_index >= MAX_TOPICS || priority > MSG_PRIORITY_CRITICAL) {
+        return false;
+    }
+    size = memory_pool_block_footprint(size);
+
+    portENTER_CRITICAL(&budget_ctx.mux);
+    topic_budget_t *topic = &budget_ctx.topics[topic_index];
+    size_t limit;
+    switch (priority) {
+        case MSG_PRIORITY_LOW:
+            limit = budget_ctx.soft_watermark;
+            break;
+        case MSG_PRIORITY_CRITICAL:
+            limit = budget_ctx.config.total_bytes;
+            break;
+        default:
+            limit = budget_ctx.hard_watermark;
+            break;
+    }
+
+    bool admitted = budget_ctx.used_bytes + size <= limit;
+    if (admitted && priority != MSG_PRIORITY_CRITICAL && topic->limit_bytes > 0) {
+        admitted = topic->used_bytes + size <= topic->limit_bytes;
+    }
+
+    if (admitted) {
+        budget_ctx.used_bytes += size;
+        topic->used_bytes += size;
+        if (topic->used_bytes > topic->peak_bytes) {
+            topic->peak_bytes = topic->used_bytes;
+        }
+    } else {
+        topic->shed_count[priority]++;
+    }
+    portEXIT_CRITICAL(&budget_ctx.mux);
+
+    return admitted;
+}
+
+void memory_budget_release(uint32_t topic_index, size_t size) {
+    if (topic_index >= MAX_TOPICS) {
+        return;
+    }
+    size = memory_pool_block_footprint(size);
+
+    portENTER_CRITICAL(&budget_ctx.mux);
+    topic_budget_t *topic = &budget_ctx.topics[topic_index];
+    topic->used_bytes = topic->used_bytes > size ? topic->used_bytes - size : 0;
+    budget_ctx.used_bytes = budget_ctx.used_bytes > size ? budget_ctx.used_bytes - size : 0;
+    portEXIT_CRITICAL(&budget_ctx.mux);
+}
+
+esp_err_t memory_budget_set_topic_limit(uint32_t topic_index, size_t limit_bytes) {
+    if (topic_index >= MAX_TOPICS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&budget_ctx.mux);
+    budget_ctx.topics[topic_index].limit_bytes = limit_bytes;
+    portEXIT_CRITICAL(&budget_ctx.mux);
+    return ESP_OK;
+}
+
+esp_err_t memory_budget_get_topic_stats(uint32_t topic_index, memory_budget_topic_stats_t *stats) {
+    if (topic_index >= MAX_TOPICS || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&budget_ctx.mux);
+    const topic_budget_t *topic = &budget_ctx.topics[topic_index];
+    stats->used_bytes = topic->used_bytes;
+    stats->peak_bytes = topic->peak_bytes;
+    stats->limit_bytes = topic->limit_bytes;
+    memcpy(stats->shed_count, topic->shed_count, sizeof(stats->shed_count));
+    portEXIT_CRITICAL(&budget_ctx.mux);
+    return ESP_OK;
+}
+
+void memory_budget_get_usage(size_t *used, size_t *soft_watermark, size_t *total) {
+    portENTER_CRITICAL(&budget_ctx.mux);
+    if (used) *used = budget_ctx.used_bytes;
+    if (soft_watermark) *soft_watermark = budget_ctx.soft_watermark;
+    if (total) *total = budget_ctx.config.total_bytes;
+    portEXIT_CRITICAL(&budget_ctx.mux);
+}
@@ -2,12 +2,19 @@
 #include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "esp_log.h"
 #include <string.h>
 
+#define TAG "MEMORY_POOL"
+#define CALLSITE_NONE 0xFF
+
 typedef struct block_header {
     struct block_header *next;
     size_t size;
     bool is_free;
+#ifdef MEMORY_POOL_PROFILING
+    uint8_t site;                  // 调用点表索引
+#endif
 } block_header_t;
 
 struct memory_pool_t {
@@ -17,10 +24,70 @@ struct memory_pool_t {
     size_t total_size;
     size_t used_size;
     size_t peak_use;
+    uint32_t alloc_failures;
+#ifdef MEMORY_POOL_PROFILING
+    uint32_t histogram[MEMORY_POOL_HISTOGRAM_BUCKETS];
+    memory_pool_callsite_t callsites[MEMORY_POOL_MAX_CALLSITES];
+    uint32_t untracked_allocs;
+#endif
 };
 
 static memory_pool_t g_memory_pool;
 
+#ifdef MEMORY_POOL_PROFILING
+// 按2的幂划分大小桶: 第0桶 <=16 字节, 最后一桶为溢出桶
+static int histogram_bucket(size_t size) {
+    int bucket = 0;
+    size_t limit = 16;
+    while (size > limit && bucket < MEMORY_POOL_HISTOGRAM_BUCKETS - 1) {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// 开放寻址查找调用点, 表满时返回 CALLSITE_NONE
+static uint8_t callsite_lookup(const char *file, int line) {
+    uint32_t hash = ((uint32_t)(uintptr_t)file >> 2) ^ ((uint32_t)line * 2654435761u);
+    for (int probe = 0; probe < MEMORY_POOL_MAX_CALLSITES; probe++) {
+        int idx = (hash + probe) % MEMORY_POOL_MAX_CALLSITES;
+        memory_pool_callsite_t *site = &g_memory_pool.callsites[idx];
+        if (site->file == NULL) {
+            site->file = file;
+            site->line = line;
+            return idx;
+        }
+        if (site->file == file && site->line == line) {
+            return idx;
+        }
+    }
+    return CALLSITE_NONE;
+}
+
+static void profile_on_alloc(block_header_t *block, const char *file, int line) {
+    g_memory_pool.histogram[histogram_bucket(block->size)]++;
+    block->site = callsite_lookup(file, line);
+    if (block->site == CALLSITE_NONE) {
+        g_memory_pool.untracked_allocs++;
+        return;
+    }
+    memory_pool_callsite_t *site = &g_memory_pool.callsites[block->site];
+    site->live_count++;
+    site->live_bytes += block->size;
+    site->total_count++;
+}
+
+static void profile_on_free(block_header_t *block) {
+    g_memory_pool.histogram[histogram_bucket(block->size)]--;
+    if (block->site == CALLSITE_NONE) {
+        return;
+    }
+    memory_pool_callsite_t *site = &g_memory_pool.callsites[block->site];
+    site->live_count--;
+    site->live_bytes -= block->size;
+}
+#endif
+
 esp_err_t memory_pool_init(void) {
     // 分配内存池空间
     g_memory_pool.pool = heap_caps_malloc(MEMORY_POOL_BLOCKS * MEMORY_BLOCK_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
@@ -44,11 +111,21 @@ esp_err_t memory_pool_init(void) {
     g_memory_pool.total_size = MEMORY_POOL_BLOCKS * MEMORY_BLOCK_SIZE;
     g_memory_pool.used_size = 0;
     g_memory_pool.peak_use = 0;
+    g_memory_pool.alloc_failures = 0;
+#ifdef MEMORY_POOL_PROFILING
+    memset(g_memory_pool.histogram, 0, sizeof(g_memory_pool.histogram));
+    memset(g_memory_pool.callsites, 0, sizeof(g_memory_pool.callsites));
+    g_memory_pool.untracked_allocs = 0;
+#endif
 
     return ESP_OK;
 }
 
+#ifdef MEMORY_POOL_PROFILING
+void *memory_pool_alloc_trace(size_t size, const char *file, int line) {
+#else
 void *memory_pool_alloc(size_t size) {
+#endif
     if (size == 0) return NULL;
 
     xSemaphoreTake(g_memory_pool.mutex, portMAX_DELAY);
@@ -74,6 +151,7 @@ void *memory_pool_alloc(size_t size) {
     }
 
     if (!best_fit) {
+        g_memory_pool.alloc_failures++;
         xSemaphoreGive(g_memory_pool.mutex);
         return NULL;
     }
@@ -94,6 +172,9 @@ void *memory_pool_alloc(size_t size) {
     if (g_memory_pool.used_size > g_memory_pool.peak_use) {
         g_memory_pool.peak_use = g_memory_pool.used_size;
     }
+#ifdef MEMORY_POOL_PROFILING
+    profile_on_alloc(best_fit, file, line);
+#endif
 
     xSemaphoreGive(g_memory_pool.mutex);
     return (void *)((uint8_t *)best_fit + sizeof(block_header_t));
@@ -106,6 +187,9 @@ void memory_pool_free(void *ptr) {
 
     block_header_t *block = (block_header_t *)((uint8_t *)ptr - sizeof(block_header_t));
     block->is_free = true;
+#ifdef MEMORY_POOL_PROFILING
+    profile_on_free(block);
+#endif
     g_memory_pool.used_size -= (block->size + sizeof(block_header_t));
 
     // 合并相邻的空闲块
@@ -128,4 +212,79 @@ void memory_pool_stats(size_t *total, size_t *used, size_t *peak) {
     if (used) *used = g_memory_pool.used_size;
     if (peak) *peak = g_memory_pool.peak_use;
     xSemaphoreGive(g_memory_pool.mutex);
-} 
\ No newline at end of file
+}
+
+size_t memory_pool_block_footprint(size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    // 与 memory_pool_alloc 相同的 8 字节对齐; 不足以分割的剩余部分不超过一个块头加 8 字节
+    return ((size + 7) & ~7) + sizeof(block_header_t);
+}
+
+void memory_pool_get_frag_stats(memory_pool_frag_stats_t *stats) {
+    if (!stats) return;
+
+    memset(stats, 0, sizeof(memory_pool_frag_stats_t));
+
+    xSemaphoreTake(g_memory_pool.mutex, portMAX_DELAY);
+    for (block_header_t *current = g_memory_pool.first_block; current != NULL; current = current->next) {
+        if (current->is_free) {
+            stats->free_bytes += current->size;
+            stats->free_block_count++;
+            if (current->size > stats->largest_free_block) {
+                stats->largest_free_block = current->size;
+            }
+        } else {
+            stats->used_block_count++;
+        }
+    }
+    stats->alloc_failures = g_memory_pool.alloc_failures;
+    xSemaphoreGive(g_memory_pool.mutex);
+}
+
+#ifdef MEMORY_POOL_PROFILING
+void memory_pool_get_histogram(uint32_t histogram[MEMORY_POOL_HISTOGRAM_BUCKETS]) {
+    if (!histogram) return;
+
+    xSemaphoreTake(g_memory_pool.mutex, portMAX_DELAY);
+    memcpy(histogram, g_memory_pool.histogram, sizeof(g_memory_pool.histogram));
+    xSemaphoreGive(g_memory_pool.mutex);
+}
+
+int memory_pool_get_callsites(memory_pool_callsite_t *sites, int max_sites) {
+    if (!sites || max_sites <= 0) return 0;
+
+    int count = 0;
+    xSemaphoreTake(g_memory_pool.mutex, portMAX_DELAY);
+    for (int i = 0; i < MEMORY_POOL_MAX_CALLSITES && count < max_sites; i++) {
+        if (g_memory_pool.callsites[i].file != NULL) {
+            sites[count++] = g_memory_pool.callsites[i];
+        }
+    }
+    xSemaphoreGive(g_memory_pool.mutex);
+    return count;
+}
+
+void memory_pool_dump_leaks(void) {
+    xSemaphoreTake(g_memory_pool.mutex, portMAX_DELAY);
+    uint32_t live = 0;
+    for (block_header_t *current = g_memory_pool.first_block; current != NULL; current = current->next) {
+        if (current->is_free) {
+            continue;
+        }
+        live++;
+        if (current->site == CALLSITE_NONE) {
+            ESP_LOGW(TAG, "Live block %p, size %u, site unknown",
+                     (void *)(current + 1), (unsigned)current->size);
+        } else {
+            const memory_pool_callsite_t *site = &g_memory_pool.callsites[current->site];
+            ESP_LOGW(TAG, "Live block %p, size %u, allocated at %s:%d",
+                     (void *)(current + 1), (unsigned)current->size, site->file, site->line);
+        }
+    }
+    ESP_LOGI(TAG, "%u live blocks, %u bytes used, %u untracked allocations",
+             live, (unsigned)g_memory_pool.used_size, g_memory_pool.untracked_allocs);
+    xSemaphoreGive(g_memory_pool.mutex);
+}
+#endif
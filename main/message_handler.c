@@ -1,13 +1,31 @@
 #include "message_handler.h"
 #include "memory_pool.h"
+#include "memory_budget.h"
+#include "object_pool.h"
 #include "error_handler.h"
+#include "timer_wheel.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
-#include "freertos/timers.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include <string.h>
 
 #define TAG "MSG_HANDLER"
 #define MAX_PENDING_MESSAGES 100
 #define MAX_RETRY_COUNT 5
+// 在途消息表按 msg_id 低位直接索引, 大小为2的幂且不小于 MAX_PENDING_MESSAGES
+#define INFLIGHT_TABLE_SIZE 128
+#define INFLIGHT_TABLE_MASK (INFLIGHT_TABLE_SIZE - 1)
+
+// 重传超时估计 (RFC 6298 风格)
+#define DEFAULT_MIN_RTO_MS 200
+#define DEFAULT_MAX_RTO_MS 60000
+#define DEFAULT_RETRY_BUDGET_PERCENT 20
+#define RETRY_BUDGET_MAX_BURST 10      // 预算最多累积的重传次数
+#define TOPIC_STATE_NONE 0xFF
+#define MAX_ACK_COALESCERS 8
+#define MAX_FLOW_WAITERS 8             // 每个等待者占用事件组的一位, 不超过 24
+#define MAX_OUTBOUND 32                // 等待在锁外发布的发送数
 
 typedef struct pending_message {
     uint32_t msg_id;
@@ -18,36 +36,384 @@ typedef struct pending_message {
     topic_qos_t qos;
     uint32_t retry_count;
     uint32_t max_retries;
-    TimerHandle_t retry_timer;
-    struct pending_message *next;
+    uint8_t topic_index;           // 所属主题在主题状态表中的位置
+    uint8_t budget_index;          // 所属主题在 pubsub 主题表中的位置, 载荷副本按此计入内存预算
+    int64_t send_time_us;          // 首次发送时间, 用于计算 RTT
+    bool sent;                     // false 表示因窗口已满仍在延迟队列中
+    timer_wheel_timer_t retry_timer;
+    struct pending_message *next;  // 延迟队列链接
 } pending_message_t;
 
+// 等待在锁外发布的一次发送. 载荷是锁内复制的副本, 发布时所有权转交 pubsub,
+// 之后描述符被确认释放也不受影响
+typedef struct {
+    char topic[MAX_TOPIC_NAME_LENGTH];
+    uint8_t *data;
+    uint32_t data_len;
+    msg_priority_t priority;
+    uint32_t msg_id;
+} outbound_t;
+
+// 每个主题的 RTT 估计器与在途窗口
+typedef struct {
+    char topic[MAX_TOPIC_NAME_LENGTH];
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint32_t rto_ms;
+    uint32_t inflight;             // 已发送未确认的消息数
+    uint32_t window;               // 主题在途窗口 (0 = 仅受全局窗口限制)
+    message_rtt_stats_t stats;
+} topic_state_t;
+
+OBJECT_POOL_DEFINE(pending_pool, pending_message_t, MAX_PENDING_MESSAGES)
+
 static struct {
     message_handler_config_t config;
-    pending_message_t *pending_messages;
+    pending_message_t *inflight[INFLIGHT_TABLE_SIZE];
+    uint32_t inflight_count;
     uint32_t next_msg_id;
+    topic_state_t topics[MAX_TOPICS];
+    uint32_t topic_count;
+    uint32_t retry_credits;        // 重传预算, 单位为 1/100 次重传
+    uint32_t window_used;          // 全局已发送未确认的消息数
+    pending_message_t *deferred_head;
+    pending_message_t *deferred_tail;
+    outbound_t outbound[MAX_OUTBOUND];
+    uint32_t outbound_head;
+    uint32_t outbound_count;
+    // 阻塞等待窗口的发布者各占一位, 不占用调用者任务的通知
+    uint32_t waiter_mask;
+    EventGroupHandle_t waiter_events;
     SemaphoreHandle_t lock;
 } message_handler_ctx;
 
-static void retry_timer_callback(TimerHandle_t timer) {
-    pending_message_t *msg = (pending_message_t *)pvTimerGetTimerID(timer);
-    
+// 以下 inflight_* 函数均需在持有 message_handler_ctx.lock 时调用
+static pending_message_t *inflight_lookup(uint32_t msg_id) {
+    pending_message_t *msg = message_handler_ctx.inflight[msg_id & INFLIGHT_TABLE_MASK];
+    return (msg != NULL && msg->msg_id == msg_id) ? msg : NULL;
+}
+
+// 分配单调递增的消息ID, 跳过在途表中仍被占用的槽位; 表满时返回0
+static uint32_t inflight_allocate_id(void) {
+    for (int i = 0; i < INFLIGHT_TABLE_SIZE; i++) {
+        uint32_t msg_id = message_handler_ctx.next_msg_id++;
+        if (msg_id == 0) {
+            continue;
+        }
+        if (message_handler_ctx.inflight[msg_id & INFLIGHT_TABLE_MASK] == NULL) {
+            return msg_id;
+        }
+    }
+    return 0;
+}
+
+static void inflight_insert(pending_message_t *msg) {
+    message_handler_ctx.inflight[msg->msg_id & INFLIGHT_TABLE_MASK] = msg;
+    message_handler_ctx.inflight_count++;
+}
+
+// 查找或登记主题状态, 需持有锁
+static uint8_t topic_state_lookup(const char *topic_name) {
+    for (uint32_t i = 0; i < message_handler_ctx.topic_count; i++) {
+        if (strcmp(message_handler_ctx.topics[i].topic, topic_name) == 0) {
+            return i;
+        }
+    }
+    if (message_handler_ctx.topic_count >= MAX_TOPICS) {
+        return TOPIC_STATE_NONE;
+    }
+
+    topic_state_t *state = &message_handler_ctx.topics[message_handler_ctx.topic_count];
+    memset(state, 0, sizeof(topic_state_t));
+    strncpy(state->topic, topic_name, MAX_TOPIC_NAME_LENGTH - 1);
+    state->rto_ms = message_handler_ctx.config.retry_interval_ms;
+    return message_handler_ctx.topic_count++;
+}
+
+static uint32_t rtt_current_rto(uint8_t topic_index) {
+    if (topic_index == TOPIC_STATE_NONE) {
+        return message_handler_ctx.config.retry_interval_ms;
+    }
+    return message_handler_ctx.topics[topic_index].rto_ms;
+}
+
+// 用一个 RTT 样本更新 SRTT/RTTVAR 并重新计算 RTO
+static void rtt_update(uint8_t topic_index, uint32_t sample_us) {
+    if (topic_index == TOPIC_STATE_NONE) {
+        return;
+    }
+
+    topic_state_t *rtt = &message_handler_ctx.topics[topic_index];
+    if (rtt->stats.samples == 0) {
+        rtt->srtt_us = sample_us;
+        rtt->rttvar_us = sample_us / 2;
+        rtt->stats.min_rtt_ms = sample_us / 1000;
+    } else {
+        uint32_t delta = rtt->srtt_us > sample_us ? rtt->srtt_us - sample_us : sample_us - rtt->srtt_us;
+        rtt->rttvar_us = (3 * rtt->rttvar_us + delta) / 4;
+        rtt->srtt_us = (7 * rtt->srtt_us + sample_us) / 8;
+    }
+
+    uint32_t rto_ms = (rtt->srtt_us + 4 * rtt->rttvar_us) / 1000;
+    if (rto_ms < message_handler_ctx.config.min_rto_ms) {
+        rto_ms = message_handler_ctx.config.min_rto_ms;
+    } else if (rto_ms > message_handler_ctx.config.max_rto_ms) {
+        rto_ms = message_handler_ctx.config.max_rto_ms;
+    }
+    rtt->rto_ms = rto_ms;
+
+    uint32_t sample_ms = sample_us / 1000;
+    if (sample_ms < rtt->stats.min_rtt_ms) rtt->stats.min_rtt_ms = sample_ms;
+    if (sample_ms > rtt->stats.max_rtt_ms) rtt->stats.max_rtt_ms = sample_ms;
+    rtt->stats.samples++;
+}
+
+// 指数退避并叠加 ±12.5% 的随机抖动, 避免大量消息同时重传
+static uint32_t retry_backoff_ms(const pending_message_t *msg) {
+    uint32_t delay = rtt_current_rto(msg->topic_index);
+    for (uint32_t i = 0; i < msg->retry_count && delay < message_handler_ctx.config.max_rto_ms; i++) {
+        delay <<= 1;
+    }
+    if (delay > message_handler_ctx.config.max_rto_ms) {
+        delay = message_handler_ctx.config.max_rto_ms;
+    }
+
+    uint32_t jitter = delay / 8;
+    if (jitter > 0) {
+        delay = delay - jitter + esp_random() % (2 * jitter + 1);
+    }
+    return delay;
+}
+
+// 每次首次发送为重传预算增加 retry_budget_percent 个单位
+static void retry_budget_deposit(void) {
+    uint32_t max_credits = RETRY_BUDGET_MAX_BURST * 100;
+    message_handler_ctx.retry_credits += message_handler_ctx.config.retry_budget_percent;
+    if (message_handler_ctx.retry_credits > max_credits) {
+        message_handler_ctx.retry_credits = max_credits;
+    }
+}
+
+static bool retry_budget_withdraw(void) {
+    if (message_handler_ctx.retry_credits < 100) {
+        return false;
+    }
+    message_handler_ctx.retry_credits -= 100;
+    return true;
+}
+
+// 在途窗口: 全局和主题窗口都有空位时才允许发送, 需持有锁
+static bool window_available(uint8_t topic_index) {
+    if (message_handler_ctx.window_used >= message_handler_ctx.config.max_inflight) {
+        return false;
+    }
+    if (topic_index != TOPIC_STATE_NONE) {
+        const topic_state_t *state = &message_handler_ctx.topics[topic_index];
+        if (state->window > 0 && state->inflight >= state->window) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void deferred_append(pending_message_t *msg) {
+    msg->next = NULL;
+    if (message_handler_ctx.deferred_tail) {
+        message_handler_ctx.deferred_tail->next = msg;
+    } else {
+        message_handler_ctx.deferred_head = msg;
+    }
+    message_handler_ctx.deferred_tail = msg;
+}
+
+static void deferred_remove(pending_message_t *msg) {
+    pending_message_t **link = &message_handler_ctx.deferred_head;
+    pending_message_t *prev = NULL;
+    while (*link != NULL && *link != msg) {
+        prev = *link;
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        return;
+    }
+    *link = msg->next;
+    if (message_handler_ctx.deferred_tail == msg) {
+        message_handler_ctx.deferred_tail = prev;
+    }
+    msg->next = NULL;
+}
+
+// 为一次发送复制载荷, 需持有锁
+static bool outbound_prepare(const pending_message_t *msg, outbound_t *out) {
+    out->data = memory_pool_alloc(msg->data_len);
+    if (out->data == NULL) {
+        return false;
+    }
+    memcpy(out->data, msg->data, msg->data_len);
+    strcpy(out->topic, msg->topic);
+    out->data_len = msg->data_len;
+    out->priority = msg->priority;
+    out->msg_id = msg->msg_id;
+    return true;
+}
+
+// 放入待发布队列, 由释放锁后的 outbound_drain 发出, 需持有锁
+// 队列已满或复制失败时放弃这次发送, 由重传定时器补发
+static void outbound_push(const pending_message_t *msg) {
+    if (message_handler_ctx.outbound_count == MAX_OUTBOUND) {
+        ERROR_REPORT(ERROR_LEVEL_WARNING, ERROR_CODE_QUEUE_FULL,
+                    "Outbound queue full, message %d to topic %s waits for retry",
+                    msg->msg_id, msg->topic);
+        return;
+    }
+    uint32_t slot = (message_handler_ctx.outbound_head + message_handler_ctx.outbound_count) % MAX_OUTBOUND;
+    if (!outbound_prepare(msg, &message_handler_ctx.outbound[slot])) {
+        ERROR_REPORT(ERROR_LEVEL_WARNING, ERROR_CODE_MEMORY_ALLOCATION_FAILED,
+                    "No memory to send message %d to topic %s, waits for retry",
+                    msg->msg_id, msg->topic);
+        return;
+    }
+    message_handler_ctx.outbound_count++;
+}
+
+static pubsub_err_t outbound_publish(outbound_t *out) {
+    pubsub_err_t err = pubsub_publish_owned_with_id(out->topic, out->data, out->data_len,
+                                                    out->priority, out->msg_id, 0);
+    if (err != PUBSUB_OK) {
+        // 失败时载荷仍归调用者
+        memory_pool_free(out->data);
+    }
+    return err;
+}
+
+// 发出待发布队列, 必须在不持有锁时调用. 订阅者回调在持有主题锁时会调用确认接口,
+// 若在本模块锁内调用 pubsub (获取 topics_lock), 会与订阅路径构成加锁环
+static void outbound_drain(void) {
+    while (1) {
+        xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+        if (message_handler_ctx.outbound_count == 0) {
+            xSemaphoreGive(message_handler_ctx.lock);
+            return;
+        }
+        outbound_t out = message_handler_ctx.outbound[message_handler_ctx.outbound_head];
+        message_handler_ctx.outbound_head = (message_handler_ctx.outbound_head + 1) % MAX_OUTBOUND;
+        message_handler_ctx.outbound_count--;
+        xSemaphoreGive(message_handler_ctx.lock);
+
+        if (outbound_publish(&out) != PUBSUB_OK) {
+            ERROR_REPORT(ERROR_LEVEL_ERROR, ERROR_CODE_SYSTEM_ERROR,
+                        "Failed to send message %d to topic %s",
+                        out.msg_id, out.topic);
+        }
+    }
+}
+
+// 首次发送: 占用窗口, 开始计时并启动重传定时器, 需持有锁
+// out 为 NULL 时放入待发布队列; 否则复制到 out 由调用者在锁外发布, 复制失败返回 false
+static bool pending_send(pending_message_t *msg, outbound_t *out) {
+    msg->sent = true;
+    msg->send_time_us = esp_timer_get_time();
+    message_handler_ctx.window_used++;
+    if (msg->topic_index != TOPIC_STATE_NONE) {
+        message_handler_ctx.topics[msg->topic_index].inflight++;
+    }
+    retry_budget_deposit();
+
+    // 启动重试定时器, 超时时间取该主题当前的 RTO
+    timer_wheel_start(&msg->retry_timer, retry_backoff_ms(msg), 0);
+    if (out == NULL) {
+        outbound_push(msg);
+        return true;
+    }
+    return outbound_prepare(msg, out);
+}
+
+// 窗口打开后按 FIFO 顺序发送延迟队列中可发送的消息, 并唤醒阻塞的发布者
+static void window_opened(void) {
+    pending_message_t *msg = message_handler_ctx.deferred_head;
+    while (msg != NULL && message_handler_ctx.window_used < message_handler_ctx.config.max_inflight) {
+        pending_message_t *next = msg->next;
+        if (window_available(msg->topic_index)) {
+            deferred_remove(msg);
+            pending_send(msg, NULL);
+        }
+        msg = next;
+    }
+
+    if (message_handler_ctx.waiter_mask != 0) {
+        xEventGroupSetBits(message_handler_ctx.waiter_events, message_handler_ctx.waiter_mask);
+    }
+}
+
+// 从在途表移除并把定时器、载荷和描述符归还各自的池
+static void inflight_release(pending_message_t *msg) {
+    timer_wheel_stop(&msg->retry_timer);
+    if (msg->sent) {
+        message_handler_ctx.window_used--;
+        if (msg->topic_index != TOPIC_STATE_NONE) {
+            message_handler_ctx.topics[msg->topic_index].inflight--;
+        }
+    } else {
+        deferred_remove(msg);
+    }
+    message_handler_ctx.inflight[msg->msg_id & INFLIGHT_TABLE_MASK] = NULL;
+    message_handler_ctx.inflight_count--;
+    memory_pool_free(msg->data);
+    memory_budget_release(msg->budget_index, msg->data_len);
+    pending_pool_free(msg);
+
+    window_opened();
+}
+
+// 确认成功: 采集 RTT 样本后释放
+static void inflight_retire(pending_message_t *msg, int64_t now_us) {
+    // Karn 算法: 重传过的消息无法确定确认对应哪次发送, 不作为 RTT 样本;
+    // 仍在延迟队列中的消息还没有发送时间
+    if (msg->sent && msg->retry_count == 0) {
+        rtt_update(msg->topic_index, (uint32_t)(now_us - msg->send_time_us));
+    }
+    inflight_release(msg);
+}
+
+// 定时器参数为 msg_id 而非指针, 避免与确认路径并发释放时访问已释放的描述符
+// 运行在共享时间轮任务上, 发布同样放到锁外, 不能阻塞其他定时器
+static void retry_timer_callback(void *arg) {
+    uint32_t msg_id = (uint32_t)(uintptr_t)arg;
+
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+
+    pending_message_t *msg = inflight_lookup(msg_id);
+    if (msg == NULL) {
+        // 已被确认或取消
+        xSemaphoreGive(message_handler_ctx.lock);
+        return;
+    }
+
     if (msg->retry_count >= msg->max_retries) {
         ERROR_REPORT(ERROR_LEVEL_WARNING, ERROR_CODE_TIMEOUT,
                     "Message %d to topic %s exceeded max retries",
                     msg->msg_id, msg->topic);
+        inflight_release(msg);
+        xSemaphoreGive(message_handler_ctx.lock);
+        outbound_drain();
         return;
     }
 
-    // 重试发布消息
-    esp_err_t err = pubsub_publish(msg->topic, msg->data, msg->data_len, msg->priority);
-    if (err != ESP_OK) {
-        ERROR_REPORT(ERROR_LEVEL_ERROR, ERROR_CODE_SYSTEM_ERROR,
-                    "Failed to retry message %d to topic %s",
-                    msg->msg_id, msg->topic);
+    topic_state_t *rtt = msg->topic_index != TOPIC_STATE_NONE ?
+                       &message_handler_ctx.topics[msg->topic_index] : NULL;
+
+    // 重传预算耗尽时跳过本次重传, 但仍计入重试次数以限制消息寿命
+    if (retry_budget_withdraw()) {
+        outbound_push(msg);
+        if (rtt) rtt->stats.retransmits++;
+    } else if (rtt) {
+        rtt->stats.retries_suppressed++;
     }
 
     msg->retry_count++;
+    timer_wheel_start(&msg->retry_timer, retry_backoff_ms(msg), 0);
+    xSemaphoreGive(message_handler_ctx.lock);
+    outbound_drain();
 }
 
 esp_err_t message_handler_init(const message_handler_config_t *config) {
@@ -60,57 +426,153 @@ esp_err_t message_handler_init(const message_handler_config_t *config) {
         return ESP_ERR_NO_MEM;
     }
 
+    message_handler_ctx.waiter_events = xEventGroupCreate();
+    if (message_handler_ctx.waiter_events == NULL) {
+        vSemaphoreDelete(message_handler_ctx.lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = timer_wheel_init(TIMER_WHEEL_DEFAULT_TICK_MS);
+    if (err != ESP_OK) {
+        vEventGroupDelete(message_handler_ctx.waiter_events);
+        vSemaphoreDelete(message_handler_ctx.lock);
+        return err;
+    }
+
+    pending_pool_init();
     memcpy(&message_handler_ctx.config, config, sizeof(message_handler_config_t));
-    message_handler_ctx.pending_messages = NULL;
+    if (message_handler_ctx.config.min_rto_ms == 0) {
+        message_handler_ctx.config.min_rto_ms = DEFAULT_MIN_RTO_MS;
+    }
+    if (message_handler_ctx.config.max_rto_ms == 0) {
+        message_handler_ctx.config.max_rto_ms = DEFAULT_MAX_RTO_MS;
+    }
+    if (message_handler_ctx.config.retry_budget_percent == 0) {
+        message_handler_ctx.config.retry_budget_percent = DEFAULT_RETRY_BUDGET_PERCENT;
+    }
+    if (message_handler_ctx.config.max_inflight == 0 ||
+        message_handler_ctx.config.max_inflight > MAX_PENDING_MESSAGES) {
+        message_handler_ctx.config.max_inflight = MAX_PENDING_MESSAGES;
+    }
+    message_handler_ctx.window_used = 0;
+    message_handler_ctx.deferred_head = NULL;
+    message_handler_ctx.deferred_tail = NULL;
+    message_handler_ctx.outbound_head = 0;
+    message_handler_ctx.outbound_count = 0;
+    message_handler_ctx.waiter_mask = 0;
+    message_handler_ctx.topic_count = 0;
+    message_handler_ctx.retry_credits = RETRY_BUDGET_MAX_BURST * 100;
+    memset(message_handler_ctx.inflight, 0, sizeof(message_handler_ctx.inflight));
+    message_handler_ctx.inflight_count = 0;
     message_handler_ctx.next_msg_id = 1;
 
     return ESP_OK;
 }
 
-static pending_message_t *create_pending_message(const char *topic_name,
+static pending_message_t *create_pending_message(uint32_t msg_id,
+                                               const char *topic_name,
                                                const uint8_t *data,
                                                uint32_t data_len,
                                                msg_priority_t priority,
-                                               topic_qos_t qos) {
-    pending_message_t *msg = memory_pool_alloc(sizeof(pending_message_t));
+                                               topic_qos_t qos,
+                                               uint8_t budget_index) {
+    // 重传用的载荷副本和 pubsub 的缓冲一样占用内存池, 同样要经过预算准入
+    if (!memory_budget_admit(budget_index, data_len, priority)) {
+        return NULL;
+    }
+
+    pending_message_t *msg = pending_pool_alloc();
     if (msg == NULL) {
+        memory_budget_release(budget_index, data_len);
         return NULL;
     }
 
     msg->data = memory_pool_alloc(data_len);
     if (msg->data == NULL) {
-        memory_pool_free(msg);
+        memory_budget_release(budget_index, data_len);
+        pending_pool_free(msg);
         return NULL;
     }
 
     memcpy(msg->data, data, data_len);
     strncpy(msg->topic, topic_name, MAX_TOPIC_NAME_LENGTH - 1);
     msg->topic[MAX_TOPIC_NAME_LENGTH - 1] = '\0';
+    msg->msg_id = msg_id;
     msg->data_len = data_len;
     msg->priority = priority;
     msg->qos = qos;
     msg->retry_count = 0;
     msg->max_retries = message_handler_ctx.config.retry_count;
+    msg->topic_index = topic_state_lookup(topic_name);
+    msg->budget_index = budget_index;
+    msg->send_time_us = 0;
+    msg->sent = false;
     msg->next = NULL;
 
-    // 创建重试定时器
-    char timer_name[32];
-    snprintf(timer_name, sizeof(timer_name), "retry_timer_%u", msg->msg_id);
-    msg->retry_timer = xTimerCreate(timer_name,
-                                  pdMS_TO_TICKS(message_handler_ctx.config.retry_interval_ms),
-                                  pdTRUE,
-                                  msg,
-                                  retry_timer_callback);
-
-    if (msg->retry_timer == NULL) {
-        memory_pool_free(msg->data);
-        memory_pool_free(msg);
-        return NULL;
-    }
+    // 重试定时器挂在共享时间轮上, 不再为每条消息创建 FreeRTOS 定时器
+    timer_wheel_timer_init(&msg->retry_timer, retry_timer_callback, (void *)(uintptr_t)msg_id);
 
     return msg;
 }
 
+// 在途窗口已满时按配置的策略处理: 立即失败、阻塞等待或放入延迟队列
+// 调用时持有锁, 阻塞期间会临时释放锁
+static esp_err_t flow_wait_for_window(uint8_t topic_index, bool *defer) {
+    *defer = false;
+    if (window_available(topic_index)) {
+        return ESP_OK;
+    }
+
+    switch (message_handler_ctx.config.flow_policy) {
+        case MESSAGE_FLOW_QUEUE:
+            *defer = true;
+            return ESP_OK;
+
+        case MESSAGE_FLOW_BLOCK:
+            break;
+
+        case MESSAGE_FLOW_FAIL:
+        default:
+            return ESP_ERR_TIMEOUT;
+    }
+
+    EventBits_t bit = 0;
+    for (int i = 0; i < MAX_FLOW_WAITERS; i++) {
+        if (!(message_handler_ctx.waiter_mask & (1u << i))) {
+            bit = 1u << i;
+            break;
+        }
+    }
+    if (bit == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    // 清掉上一个占用者留下的唤醒
+    xEventGroupClearBits(message_handler_ctx.waiter_events, bit);
+    message_handler_ctx.waiter_mask |= bit;
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(message_handler_ctx.config.block_timeout_ms);
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    while (1) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            break;
+        }
+
+        xSemaphoreGive(message_handler_ctx.lock);
+        xEventGroupWaitBits(message_handler_ctx.waiter_events, bit, pdTRUE, pdFALSE, timeout - elapsed);
+        xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+
+        if (window_available(topic_index)) {
+            ret = ESP_OK;
+            break;
+        }
+    }
+
+    message_handler_ctx.waiter_mask &= ~bit;
+    return ret;
+}
+
 esp_err_t message_publish_with_qos(const char *topic_name,
                                  const uint8_t *data,
                                  uint32_t data_len,
@@ -121,36 +583,392 @@ esp_err_t message_publish_with_qos(const char *topic_name,
         return ESP_ERR_INVALID_ARG;
     }
 
-    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+    // 主题查找获取 topics_lock, 与所有 pubsub 调用一样放在本模块锁外
+    int budget_index = -1;
+    if (qos > TOPIC_QOS_AT_MOST_ONCE) {
+        budget_index = pubsub_get_topic_index(topic_name);
+        if (budget_index < 0) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
 
-    // 分配消息ID
-    *msg_id = message_handler_ctx.next_msg_id++;
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
 
-    // 对于QoS > 0的消息，创建待处理消息
+    // 对于QoS > 0的消息，创建待处理消息并登记到在途表
     if (qos > TOPIC_QOS_AT_MOST_ONCE) {
-        pending_message_t *pending = create_pending_message(topic_name,
+        bool defer = false;
+        esp_err_t err = flow_wait_for_window(topic_state_lookup(topic_name), &defer);
+        if (err != ESP_OK) {
+            xSemaphoreGive(message_handler_ctx.lock);
+            return err;
+        }
+
+        *msg_id = inflight_allocate_id();
+        if (*msg_id == 0) {
+            xSemaphoreGive(message_handler_ctx.lock);
+            return ESP_ERR_NO_MEM;
+        }
+
+        pending_message_t *pending = create_pending_message(*msg_id,
+                                                         topic_name,
                                                          data,
                                                          data_len,
                                                          priority,
-                                                         qos);
+                                                         qos,
+                                                         (uint8_t)budget_index);
         if (pending == NULL) {
             xSemaphoreGive(message_handler_ctx.lock);
             return ESP_ERR_NO_MEM;
         }
 
-        pending->msg_id = *msg_id;
+        inflight_insert(pending);
 
-        // 添加到待处理列表
-        pending->next = message_handler_ctx.pending_messages;
-        message_handler_ctx.pending_messages = pending;
+        outbound_t out;
+        bool copied = false;
+        if (defer) {
+            // 窗口已满, 待确认腾出窗口后由 window_opened 发送
+            deferred_append(pending);
+        } else {
+            copied = pending_send(pending, &out);
+        }
 
-        // 启动重试定时器
-        xTimerStart(pending->retry_timer, 0);
+        xSemaphoreGive(message_handler_ctx.lock);
+
+        // 先发出已排队的消息, 保持发送顺序
+        outbound_drain();
+        if (defer) {
+            return ESP_OK;
+        }
+        if (!copied) {
+            // 消息已在途表中, 由重传定时器补发
+            return ESP_ERR_NO_MEM;
+        }
+        err = outbound_publish(&out);
+        return err;
+    } else {
+        // 分配消息ID
+        *msg_id = message_handler_ctx.next_msg_id++;
+        if (*msg_id == 0) {
+            *msg_id = message_handler_ctx.next_msg_id++;
+        }
     }
 
-    // 发布消息
+    xSemaphoreGive(message_handler_ctx.lock);
+
+    // QoS 0 不跟踪, 不带 msg_id 发布, 不占用恰好一次主题的去重窗口
     esp_err_t err = pubsub_publish(topic_name, data, data_len, priority);
+    return err;
+}
+
+esp_err_t message_acknowledge(const char *topic_name, uint32_t msg_id) {
+    if (msg_id == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+
+    pending_message_t *msg = inflight_lookup(msg_id);
+    if (msg == NULL) {
+        xSemaphoreGive(message_handler_ctx.lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (topic_name != NULL && strcmp(msg->topic, topic_name) != 0) {
+        xSemaphoreGive(message_handler_ctx.lock);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char topic[MAX_TOPIC_NAME_LENGTH];
+    strcpy(topic, msg->topic);
+    inflight_retire(msg, esp_timer_get_time());
 
     xSemaphoreGive(message_handler_ctx.lock);
-    return err;
-} 
\ No newline at end of file
+    // 腾出的窗口可能让延迟队列中的消息进入待发布队列
+    outbound_drain();
+
+    // 在锁外通知确认回调
+    if (message_handler_ctx.config.ack_callback) {
+        message_handler_ctx.config.ack_callback(topic, msg_id, message_handler_ctx.config.user_data);
+    }
+
+    return ESP_OK;
+}
+
+// 确认单个 msg_id, 若属于该主题则释放并记入 acked 数组, 需持有锁
+static bool batch_ack_one(const char *topic_name, uint32_t msg_id, int64_t now_us,
+                          uint32_t *acked, uint32_t *acked_count) {
+    pending_message_t *msg = inflight_lookup(msg_id);
+    if (msg == NULL || strcmp(msg->topic, topic_name) != 0) {
+        return false;
+    }
+    inflight_retire(msg, now_us);
+    acked[(*acked_count)++] = msg_id;
+    return true;
+}
+
+esp_err_t message_acknowledge_batch(const char *topic_name,
+                                    uint32_t cumulative_id,
+                                    const message_ack_range_t *ranges,
+                                    size_t range_count,
+                                    uint32_t *acked_count) {
+    if (topic_name == NULL || (ranges == NULL && range_count > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // 反向区间的跨度会回绕成接近 2^32, 误确认整个主题的在途消息
+    for (size_t r = 0; r < range_count; r++) {
+        if (ranges[r].last_id < ranges[r].first_id) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    // 在途表最多 INFLIGHT_TABLE_SIZE 条, 一次调用最多确认这么多
+    uint32_t acked[INFLIGHT_TABLE_SIZE];
+    uint32_t count = 0;
+    int64_t now_us = esp_timer_get_time();
+
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+
+    // 累积确认: 扫描整张在途表, 代价固定且与确认数量无关
+    if (cumulative_id != 0) {
+        for (int i = 0; i < INFLIGHT_TABLE_SIZE; i++) {
+            pending_message_t *msg = message_handler_ctx.inflight[i];
+            if (msg != NULL && (int32_t)(cumulative_id - msg->msg_id) >= 0) {
+                batch_ack_one(topic_name, msg->msg_id, now_us, acked, &count);
+            }
+        }
+    }
+
+    // 选择性确认: 短区间逐个查表, 长区间退化为整表扫描
+    for (size_t r = 0; r < range_count; r++) {
+        uint32_t first = ranges[r].first_id;
+        uint32_t last = ranges[r].last_id;
+        if (last - first < INFLIGHT_TABLE_SIZE) {
+            for (uint32_t k = 0; k <= last - first; k++) {
+                batch_ack_one(topic_name, first + k, now_us, acked, &count);
+            }
+        } else {
+            for (int i = 0; i < INFLIGHT_TABLE_SIZE; i++) {
+                pending_message_t *msg = message_handler_ctx.inflight[i];
+                if (msg != NULL && msg->msg_id >= first && msg->msg_id <= last) {
+                    batch_ack_one(topic_name, msg->msg_id, now_us, acked, &count);
+                }
+            }
+        }
+    }
+
+    xSemaphoreGive(message_handler_ctx.lock);
+    outbound_drain();
+
+    if (message_handler_ctx.config.ack_callback) {
+        for (uint32_t i = 0; i < count; i++) {
+            message_handler_ctx.config.ack_callback(topic_name, acked[i], message_handler_ctx.config.user_data);
+        }
+    }
+
+    if (acked_count) {
+        *acked_count = count;
+    }
+    return count > 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t message_cancel(uint32_t msg_id) {
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+
+    pending_message_t *msg = inflight_lookup(msg_id);
+    if (msg == NULL) {
+        xSemaphoreGive(message_handler_ctx.lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    inflight_release(msg);
+
+    xSemaphoreGive(message_handler_ctx.lock);
+    outbound_drain();
+    return ESP_OK;
+}
+
+esp_err_t message_set_retry_policy(uint32_t retry_count, uint32_t retry_interval_ms) {
+    if (retry_count > MAX_RETRY_COUNT || retry_interval_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+    message_handler_ctx.config.retry_count = retry_count;
+    message_handler_ctx.config.retry_interval_ms = retry_interval_ms;
+    xSemaphoreGive(message_handler_ctx.lock);
+
+    return ESP_OK;
+}
+
+uint32_t message_get_inflight_count(void) {
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+    uint32_t count = message_handler_ctx.inflight_count;
+    xSemaphoreGive(message_handler_ctx.lock);
+    return count;
+}
+
+esp_err_t message_get_rtt_stats(const char *topic_name, message_rtt_stats_t *stats) {
+    if (topic_name == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < message_handler_ctx.topic_count; i++) {
+        const topic_state_t *rtt = &message_handler_ctx.topics[i];
+        if (strcmp(rtt->topic, topic_name) == 0) {
+            memcpy(stats, &rtt->stats, sizeof(message_rtt_stats_t));
+            stats->srtt_ms = rtt->srtt_us / 1000;
+            stats->rttvar_ms = rtt->rttvar_us / 1000;
+            stats->rto_ms = rtt->rto_ms;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(message_handler_ctx.lock);
+
+    return ret;
+}
+
+// 接收端确认合并器: 把收到的 msg_id 合并成区间, 达到条数或超时后一次性确认
+struct message_ack_coalescer {
+    char topic[MAX_TOPIC_NAME_LENGTH];
+    message_ack_coalescer_config_t config;
+    message_ack_range_t ranges[MESSAGE_ACK_MAX_RANGES];
+    size_t range_count;
+    uint32_t pending;
+    timer_wheel_timer_t flush_timer;
+    portMUX_TYPE mux;
+};
+
+OBJECT_POOL_DEFINE(coalescer_pool, message_ack_coalescer_t, MAX_ACK_COALESCERS)
+static bool coalescer_pool_ready = false;
+
+static void coalescer_flush_timer_callback(void *arg) {
+    message_ack_coalescer_flush((message_ack_coalescer_t *)arg);
+}
+
+esp_err_t message_ack_coalescer_create(const char *topic_name,
+                                       const message_ack_coalescer_config_t *config,
+                                       message_ack_coalescer_t **coalescer) {
+    if (topic_name == NULL || config == NULL || coalescer == NULL ||
+        config->max_pending == 0 || config->flush_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+    if (!coalescer_pool_ready) {
+        coalescer_pool_init();
+        coalescer_pool_ready = true;
+    }
+    xSemaphoreGive(message_handler_ctx.lock);
+
+    message_ack_coalescer_t *c = coalescer_pool_alloc();
+    if (c == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(c, 0, sizeof(message_ack_coalescer_t));
+    strncpy(c->topic, topic_name, MAX_TOPIC_NAME_LENGTH - 1);
+    memcpy(&c->config, config, sizeof(message_ack_coalescer_config_t));
+    portMUX_INITIALIZE(&c->mux);
+    timer_wheel_timer_init(&c->flush_timer, coalescer_flush_timer_callback, c);
+
+    *coalescer = c;
+    return ESP_OK;
+}
+
+esp_err_t message_ack_coalescer_add(message_ack_coalescer_t *coalescer, uint32_t msg_id) {
+    if (coalescer == NULL || msg_id == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool flush_now = false;
+    bool start_timer = false;
+
+    portENTER_CRITICAL(&coalescer->mux);
+    // 区间表已满且不能并入最后一个区间时先刷新
+    message_ack_range_t *last = coalescer->range_count > 0 ?
+                                &coalescer->ranges[coalescer->range_count - 1] : NULL;
+    // 不跨 msg_id 回绕合并, 区间始终满足 first_id <= last_id
+    bool extends_last = last != NULL && last->last_id != UINT32_MAX && msg_id == last->last_id + 1;
+    if (!extends_last && coalescer->range_count == MESSAGE_ACK_MAX_RANGES) {
+        portEXIT_CRITICAL(&coalescer->mux);
+        message_ack_coalescer_flush(coalescer);
+        portENTER_CRITICAL(&coalescer->mux);
+        last = NULL;
+        extends_last = false;
+    }
+
+    if (extends_last) {
+        last->last_id = msg_id;
+    } else {
+        coalescer->ranges[coalescer->range_count].first_id = msg_id;
+        coalescer->ranges[coalescer->range_count].last_id = msg_id;
+        coalescer->range_count++;
+    }
+
+    start_timer = coalescer->pending++ == 0;
+    flush_now = coalescer->pending >= coalescer->config.max_pending;
+    portEXIT_CRITICAL(&coalescer->mux);
+
+    if (flush_now) {
+        return message_ack_coalescer_flush(coalescer);
+    }
+    if (start_timer) {
+        timer_wheel_start(&coalescer->flush_timer, coalescer->config.flush_ms, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t message_ack_coalescer_flush(message_ack_coalescer_t *coalescer) {
+    if (coalescer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    message_ack_range_t ranges[MESSAGE_ACK_MAX_RANGES];
+    size_t range_count;
+
+    timer_wheel_stop(&coalescer->flush_timer);
+
+    portENTER_CRITICAL(&coalescer->mux);
+    range_count = coalescer->range_count;
+    memcpy(ranges, coalescer->ranges, range_count * sizeof(message_ack_range_t));
+    coalescer->range_count = 0;
+    coalescer->pending = 0;
+    portEXIT_CRITICAL(&coalescer->mux);
+
+    if (range_count == 0) {
+        return ESP_OK;
+    }
+    return message_acknowledge_batch(coalescer->topic, 0, ranges, range_count, NULL);
+}
+
+void message_ack_coalescer_destroy(message_ack_coalescer_t *coalescer) {
+    if (coalescer == NULL) {
+        return;
+    }
+    message_ack_coalescer_flush(coalescer);
+    // 回调在时间轮锁外执行, 可能仍在使用 coalescer
+    timer_wheel_stop_sync(&coalescer->flush_timer);
+    coalescer_pool_free(coalescer);
+}
+
+esp_err_t message_set_topic_window(const char *topic_name, uint32_t max_inflight) {
+    if (topic_name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(message_handler_ctx.lock, portMAX_DELAY);
+    uint8_t topic_index = topic_state_lookup(topic_name);
+    if (topic_index == TOPIC_STATE_NONE) {
+        xSemaphoreGive(message_handler_ctx.lock);
+        return ESP_ERR_NO_MEM;
+    }
+    message_handler_ctx.topics[topic_index].window = max_inflight;
+    // 窗口可能变大, 尝试发送延迟队列
+    window_opened();
+    xSemaphoreGive(message_handler_ctx.lock);
+    outbound_drain();
+
+    return ESP_OK;
+}
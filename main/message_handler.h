@@ -2,20 +2,61 @@
 #define MESSAGE_HANDLER_H
 
 #include "pubsub_core.h"
+#include "topic_manager_advanced.h"
 #include <stdint.h>
 
 // 消息确认回调
 typedef void (*message_ack_callback_t)(const char *topic, uint32_t msg_id, void *user_data);
 
+// 在途窗口已满时的处理策略
+typedef enum {
+    MESSAGE_FLOW_FAIL = 0,         // 立即返回 ESP_ERR_TIMEOUT
+    MESSAGE_FLOW_BLOCK,            // 阻塞等待窗口, 最多 block_timeout_ms
+    MESSAGE_FLOW_QUEUE             // 分配 msg_id 后放入延迟队列, 确认腾出窗口后发送
+} message_flow_policy_t;
+
 // 消息处理配置
 typedef struct {
     bool enable_ack;
     uint32_t retry_count;
-    uint32_t retry_interval_ms;
+    uint32_t retry_interval_ms;    // 尚无 RTT 样本时的初始重传超时
+    uint32_t min_rto_ms;           // RTO 下限 (0 = 默认值)
+    uint32_t max_rto_ms;           // RTO 及退避上限 (0 = 默认值)
+    uint32_t retry_budget_percent; // 重传数占首次发送数的最大百分比 (0 = 默认值)
+    uint32_t max_inflight;         // 全局在途窗口 (0 = MAX_PENDING_MESSAGES)
+    message_flow_policy_t flow_policy;
+    uint32_t block_timeout_ms;     // MESSAGE_FLOW_BLOCK 的最长等待时间
     message_ack_callback_t ack_callback;
     void *user_data;
 } message_handler_config_t;
 
+// 选择性确认区间 [first_id, last_id]
+typedef struct {
+    uint32_t first_id;
+    uint32_t last_id;
+} message_ack_range_t;
+
+// 接收端确认合并配置: 累积 max_pending 条或等待 flush_ms 后批量确认
+#define MESSAGE_ACK_MAX_RANGES 8
+typedef struct {
+    uint32_t max_pending;
+    uint32_t flush_ms;
+} message_ack_coalescer_config_t;
+
+typedef struct message_ack_coalescer message_ack_coalescer_t;
+
+// 主题往返时延统计
+typedef struct {
+    uint32_t srtt_ms;              // 平滑 RTT
+    uint32_t rttvar_ms;            // RTT 偏差
+    uint32_t rto_ms;               // 当前重传超时
+    uint32_t min_rtt_ms;
+    uint32_t max_rtt_ms;
+    uint32_t samples;              // 有效 RTT 样本数 (不含重传过的消息)
+    uint32_t retransmits;          // 实际重传次数
+    uint32_t retries_suppressed;   // 因重传预算耗尽而跳过的重传
+} message_rtt_stats_t;
+
 // 消息处理API
 esp_err_t message_handler_init(const message_handler_config_t *config);
 esp_err_t message_publish_with_qos(const char *topic_name, 
@@ -25,6 +66,26 @@ esp_err_t message_publish_with_qos(const char *topic_name,
                                  topic_qos_t qos,
                                  uint32_t *msg_id);
 esp_err_t message_acknowledge(const char *topic_name, uint32_t msg_id);
+// 一次确认多条消息: cumulative_id 之前 (含) 的全部消息, 以及 ranges 中的各区间
+// cumulative_id 为 0 表示不做累积确认, 区间 last_id < first_id 时返回 ESP_ERR_INVALID_ARG
+esp_err_t message_acknowledge_batch(const char *topic_name,
+                                    uint32_t cumulative_id,
+                                    const message_ack_range_t *ranges,
+                                    size_t range_count,
+                                    uint32_t *acked_count);
+esp_err_t message_cancel(uint32_t msg_id);
 esp_err_t message_set_retry_policy(uint32_t retry_count, uint32_t retry_interval_ms);
+uint32_t message_get_inflight_count(void);
+esp_err_t message_set_topic_window(const char *topic_name, uint32_t max_inflight);
+esp_err_t message_get_rtt_stats(const char *topic_name, message_rtt_stats_t *stats);
+
+// 确认合并器API
+esp_err_t message_ack_coalescer_create(const char *topic_name,
+                                       const message_ack_coalescer_config_t *config,
+                                       message_ack_coalescer_t **coalescer);
+esp_err_t message_ack_coalescer_add(message_ack_coalescer_t *coalescer, uint32_t msg_id);
+esp_err_t message_ack_coalescer_flush(message_ack_coalescer_t *coalescer);
+// 刷新剩余确认后释放, 会等待正在执行的定时刷新结束, 不能在 ack_callback 中调用
+void message_ack_coalescer_destroy(message_ack_coalescer_t *coalescer);
 
 #endif /* MESSAGE_HANDLER_H */ 
\ No newline at end of file
@@ -1,17 +1,41 @@
 #include "mqtt_client.h"
 #include "mqtt_encoder.h"
 #include "mqtt_decoder.h"
+#include "mqtt_framer.h"
+#include "mqtt_tx.h"
+#include "mqtt_inflight.h"
+#include "mqtt_packet_id.h"
+#include "mqtt_properties.h"
+#include "mqtt_topic_alias.h"
+#include "mqtt_subscriptions.h"
+#include "mqtt_compress.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
+#include "lwip/sockets.h"
+#include "esp_vfs_eventfd.h"
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define TAG "MQTT_CLIENT"
 #define MQTT_TASK_STACK_SIZE 4096
 #define MQTT_TASK_PRIORITY 5
 #define MQTT_QUEUE_SIZE 10
+#define MQTT_RX_BUFFER_SIZE 1024
+#define MQTT_TX_BUFFER_SIZE 1460
+#define MQTT_TX_MAX_MESSAGES 16
+#define MQTT_INBOUND_QOS2_MAX 16
+#define MQTT_CONTROL_PENDING_MAX 16     // 同时等待 SUBACK / UNSUBACK 的包数
+#define MQTT_DEFAULT_RETRY_INTERVAL_MS 10000
+#define MQTT_PINGRESP_TIMEOUT_MS 5000
+
+// 事件组位
+#define MQTT_ACTIVE_BIT    BIT0   // 套接字已建立 (CONNECTING 或 CONNECTED)
+#define MQTT_CONNECTED_BIT BIT1   // 已收到 CONNACK
 
 // MQTT 客户端状态
 typedef enum {
@@ -29,67 +53,480 @@ typedef struct {
     TaskHandle_t task_handle;
     QueueHandle_t msg_queue;
     EventGroupHandle_t event_group;
-    uint16_t next_packet_id;
+    int wake_fd;                   // eventfd, 入队时写入以唤醒 select
+    mqtt_packet_id_allocator_t packet_ids;   // PUBLISH / SUBSCRIBE / UNSUBSCRIBE 共用
     mqtt_callback_t callback;
     void *callback_arg;
+    mqtt_framer_t framer;
+    uint8_t rx_buf[MQTT_RX_BUFFER_SIZE];
+    mqtt_stream_handler_t stream_handler;
+    struct {
+        bool active;
+        bool discard;              // 不支持的包类型或未设置处理器, 只消耗数据
+        uint32_t offset;
+        mqtt_qos_t qos;
+        uint16_t packet_id;
+    } rx_stream;
+    mqtt_tx_batch_t tx_batch;
+    uint8_t tx_buf[MQTT_TX_BUFFER_SIZE];
+    mqtt_flush_policy_t flush_policy;
+    uint16_t tx_messages;          // 批次中的消息数
+    int64_t tx_first_us;           // 批次中第一条消息加入的时间
+    struct {
+        mqtt_publish_done_t done;
+        void *arg;
+    } tx_done[MQTT_TX_MAX_MESSAGES];
+    uint16_t tx_done_count;
+    mqtt_inflight_t inflight;
+    mqtt_qos_config_t qos_config;
+    uint16_t inbound_qos2[MQTT_INBOUND_QOS2_MAX];  // 已收到 PUBLISH, 等待 PUBREL 的 QoS 2 报文标识符
+    uint8_t inbound_qos2_count;
+    mqtt_topic_alias_table_t tx_aliases;    // MQTT 5.0 发送主题别名
+    mqtt_topic_alias_table_t rx_aliases;    // MQTT 5.0 服务端分配的接收主题别名
+    bool rx_protocol_error;        // 处理收到的包时发现需要断开连接的错误
+    uint16_t server_receive_maximum;        // 服务端 Receive Maximum
+    uint32_t server_max_packet_size;        // 服务端 Maximum Packet Size, 0 表示不限
+    mqtt_subscriptions_t subscriptions;
+    // 已发出的 SUBSCRIBE / UNSUBSCRIBE, 只有对应上的 SUBACK / UNSUBACK 才归还报文标识符
+    struct {
+        uint16_t packet_id;
+        uint8_t type;
+    } control_pending[MQTT_CONTROL_PENDING_MAX];
+    uint8_t control_pending_count;
+    mqtt_compress_ctx_t compress;  // 只由客户端任务使用压缩状态
+    int64_t last_tx_us;            // 最后一次写出数据的时间
+    int64_t ping_deadline_us;      // PINGRESP 截止时间
+    bool ping_outstanding;
 } mqtt_client_ctx_t;
 
 // 内部消息类型
 typedef struct {
     mqtt_packet_type_t type;
     union {
-        mqtt_message_t publish;
         struct {
-            const char *topic;
+            mqtt_message_t message;
+            const mqtt_publish_template_t *prepared;   // 可为 NULL
+            mqtt_publish_done_t done;
+            void *done_arg;
+        } publish;
+        // topic 为 malloc 分配的副本, 由客户端任务释放
+        struct {
+            char *topic;
             mqtt_qos_t qos;
         } subscribe;
         struct {
-            const char *topic;
+            char *topic;
         } unsubscribe;
     } data;
 } mqtt_internal_message_t;
 
 static mqtt_client_ctx_t *client_ctx = NULL;
 
-// 生成下一个报文标识符
+// 分配报文标识符, 跳过仍在等待确认的标识符, 全部占用时返回 0
 static uint16_t get_next_packet_id(void) {
-    client_ctx->next_packet_id++;
-    if (client_ctx->next_packet_id == 0) {
-        client_ctx->next_packet_id = 1;
+    return mqtt_packet_id_alloc(&client_ctx->packet_ids);
+}
+
+// 确认到达后归还报文标识符
+static void release_packet_id(uint16_t packet_id) {
+    mqtt_packet_id_release(&client_ctx->packet_ids, packet_id);
+}
+
+// 记录已发出的 SUBSCRIBE / UNSUBSCRIBE, 调用前需确认表未满
+static void control_pending_add(mqtt_packet_type_t type, uint16_t packet_id) {
+    client_ctx->control_pending[client_ctx->control_pending_count].packet_id = packet_id;
+    client_ctx->control_pending[client_ctx->control_pending_count].type = type;
+    client_ctx->control_pending_count++;
+}
+
+static bool control_pending_full(void) {
+    return client_ctx->control_pending_count >= MQTT_CONTROL_PENDING_MAX;
+}
+
+// 收到 SUBACK / UNSUBACK 时查找并移除对应的记录, 重复或不属于本客户端的确认返回 false
+static bool control_pending_take(mqtt_packet_type_t type, uint16_t packet_id) {
+    for (uint8_t i = 0; i < client_ctx->control_pending_count; i++) {
+        if (client_ctx->control_pending[i].packet_id == packet_id &&
+            client_ctx->control_pending[i].type == type) {
+            client_ctx->control_pending[i] =
+                client_ctx->control_pending[--client_ctx->control_pending_count];
+            return true;
+        }
     }
-    return client_ctx->next_packet_id;
+    return false;
 }
 
-// 发送 MQTT 数据
-static int mqtt_send_packet(const uint8_t *buf, int len) {
-    int sent = 0;
-    while (sent < len) {
-        int ret = send(client_ctx->socket, buf + sent, len - sent, 0);
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Send failed: errno %d", errno);
-            return -1;
+// 通知批次中所有发布的结果
+static void tx_complete(esp_err_t result) {
+    for (int i = 0; i < client_ctx->tx_done_count; i++) {
+        client_ctx->tx_done[i].done(result, client_ctx->tx_done[i].arg);
+    }
+    client_ctx->tx_done_count = 0;
+    client_ctx->tx_messages = 0;
+}
+
+// 用一次 sendmsg 写出当前批次
+static int tx_flush(void) {
+    if (mqtt_tx_empty(&client_ctx->tx_batch)) {
+        return 0;
+    }
+
+    int ret = mqtt_tx_flush(&client_ctx->tx_batch, client_ctx->socket);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Send failed: errno %d", errno);
+    } else {
+        client_ctx->last_tx_us = esp_timer_get_time();
+    }
+    tx_complete(ret < 0 ? ESP_FAIL : ESP_OK);
+    return ret;
+}
+
+// 丢弃未发送的批次
+static void tx_discard(void) {
+    mqtt_tx_reset(&client_ctx->tx_batch);
+    tx_complete(ESP_FAIL);
+}
+
+// 批次达到字节数或消息数上限
+static bool tx_batch_full(void) {
+    const mqtt_flush_policy_t *policy = &client_ctx->flush_policy;
+    return client_ctx->tx_batch.bytes >= policy->max_bytes ||
+           client_ctx->tx_messages >= policy->max_messages;
+}
+
+// 发送缓冲区放不下时先写出已有批次, 返回是否值得重试
+static bool tx_make_room(void) {
+    if (mqtt_tx_empty(&client_ctx->tx_batch)) {
+        return false;
+    }
+    return tx_flush() == 0;
+}
+
+// 一条消息加入批次
+static void tx_message_added(void) {
+    if (client_ctx->tx_messages++ == 0) {
+        client_ctx->tx_first_us = esp_timer_get_time();
+    }
+}
+
+// 确认包加入批次
+static int tx_append_ack(mqtt_packet_type_t type, uint16_t packet_id) {
+    mqtt_tx_batch_t *batch = &client_ctx->tx_batch;
+    uint32_t space;
+    uint8_t *dst;
+    int len;
+
+    do {
+        dst = mqtt_tx_reserve(batch, &space);
+        len = mqtt_encode_ack(type, packet_id, dst, space);
+    } while (len < 0 && tx_make_room());
+    if (len < 0) {
+        return -1;
+    }
+    mqtt_tx_commit(batch, len);
+    tx_message_added();
+    return 0;
+}
+
+// 结束一条发送中的 QoS 1/2 消息并通知调用者
+static void inflight_complete(mqtt_inflight_entry_t *entry, esp_err_t result) {
+    mqtt_publish_done_t done = entry->done;
+    void *done_arg = entry->done_arg;
+
+    release_packet_id(entry->packet_id);
+    mqtt_inflight_remove(&client_ctx->inflight, entry);
+    if (done) {
+        done(result, done_arg);
+    }
+}
+
+// 处理 PUBACK / PUBREC / PUBCOMP
+static void handle_publish_ack(mqtt_packet_type_t type, uint16_t packet_id) {
+    mqtt_inflight_entry_t *entry = mqtt_inflight_find(&client_ctx->inflight, packet_id);
+
+    switch (type) {
+        case MQTT_PUBACK:
+            if (entry && entry->state == MQTT_INFLIGHT_WAIT_PUBACK) {
+                inflight_complete(entry, ESP_OK);
+            }
+            break;
+
+        case MQTT_PUBREC:
+            if (entry && entry->state == MQTT_INFLIGHT_WAIT_PUBREC) {
+                entry->state = MQTT_INFLIGHT_WAIT_PUBCOMP;
+                entry->retries = 0;
+                mqtt_inflight_touch(&client_ctx->inflight, entry, esp_timer_get_time());
+            }
+            // 未知的标识符也回复 PUBREL, 让服务端释放状态
+            tx_append_ack(MQTT_PUBREL, packet_id);
+            break;
+
+        case MQTT_PUBCOMP:
+            if (entry && entry->state == MQTT_INFLIGHT_WAIT_PUBCOMP) {
+                inflight_complete(entry, ESP_OK);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// 记录收到的 QoS 2 PUBLISH, 重复的报文标识符返回 false
+// 表满时不能淘汰旧记录 (重发的 PUBLISH 会被再次交付), 按协议错误断开, 返回 false
+static bool inbound_qos2_mark(uint16_t packet_id) {
+    for (int i = 0; i < client_ctx->inbound_qos2_count; i++) {
+        if (client_ctx->inbound_qos2[i] == packet_id) {
+            return false;
         }
-        sent += ret;
     }
-    return sent;
+
+    // 服务端超出了声明的 Receive Maximum
+    if (client_ctx->inbound_qos2_count == MQTT_INBOUND_QOS2_MAX) {
+        ESP_LOGE(TAG, "Inbound QoS 2 table full, rejecting packet %u", packet_id);
+        client_ctx->rx_protocol_error = true;
+        return false;
+    }
+    client_ctx->inbound_qos2[client_ctx->inbound_qos2_count++] = packet_id;
+    return true;
 }
 
-// 接收 MQTT 数据
-static int mqtt_receive_packet(uint8_t *buf, int len) {
-    int received = 0;
-    while (received < len) {
-        int ret = recv(client_ctx->socket, buf + received, len - received, 0);
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Receive failed: errno %d", errno);
+// 收到 PUBREL 后释放 QoS 2 报文标识符
+static void inbound_qos2_release(uint16_t packet_id) {
+    for (int i = 0; i < client_ctx->inbound_qos2_count; i++) {
+        if (client_ctx->inbound_qos2[i] == packet_id) {
+            memmove(client_ctx->inbound_qos2 + i, client_ctx->inbound_qos2 + i + 1,
+                    (client_ctx->inbound_qos2_count - i - 1) * sizeof(uint16_t));
+            client_ctx->inbound_qos2_count--;
+            return;
+        }
+    }
+}
+
+// 接收 MQTT 数据, 一次 recv 直接写入分帧缓冲区
+static int mqtt_receive(void) {
+    uint32_t space;
+    uint8_t *dst = mqtt_framer_write_ptr(&client_ctx->framer, &space);
+    int ret = recv(client_ctx->socket, dst, space, 0);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Receive failed: errno %d", errno);
+        return -1;
+    }
+    if (ret == 0) {
+        ESP_LOGE(TAG, "Connection closed by peer");
+        return -1;
+    }
+    mqtt_framer_commit(&client_ctx->framer, ret);
+    return ret;
+}
+
+// 唤醒客户端任务, 入队和状态变化后调用
+static void mqtt_client_wake(void) {
+    uint64_t value = 1;
+    if (write(client_ctx->wake_fd, &value, sizeof(value)) < 0) {
+        ESP_LOGW(TAG, "Wake failed: errno %d", errno);
+    }
+}
+
+// 切换状态并同步事件组
+static void set_state(mqtt_client_state_t state) {
+    if (state == MQTT_STATE_CONNECTING) {
+        // 合并由发送批次完成, 关闭 Nagle 避免批次写出后再被延迟
+        int nodelay = 1;
+        setsockopt(client_ctx->socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    client_ctx->state = state;
+    if (state == MQTT_STATE_DISCONNECTED) {
+        xEventGroupClearBits(client_ctx->event_group, MQTT_ACTIVE_BIT | MQTT_CONNECTED_BIT);
+    } else if (state == MQTT_STATE_CONNECTED) {
+        xEventGroupSetBits(client_ctx->event_group, MQTT_ACTIVE_BIT | MQTT_CONNECTED_BIT);
+    } else {
+        xEventGroupClearBits(client_ctx->event_group, MQTT_CONNECTED_BIT);
+        xEventGroupSetBits(client_ctx->event_group, MQTT_ACTIVE_BIT);
+    }
+    mqtt_client_wake();
+}
+
+static bool is_v5(void) {
+    return client_ctx->connect_options.protocol_version == MQTT_PROTOCOL_V5;
+}
+
+// 应用 CONNACK 中的服务端限制, props 为 NULL 时 (MQTT 3.1.1) 使用默认值
+static void apply_connack_properties(const mqtt_properties_t *props) {
+    client_ctx->server_receive_maximum =
+        mqtt_properties_has(props, MQTT_PROP_RECEIVE_MAXIMUM) ? props->receive_maximum : UINT16_MAX;
+    client_ctx->server_max_packet_size =
+        mqtt_properties_has(props, MQTT_PROP_MAXIMUM_PACKET_SIZE) ? props->maximum_packet_size : 0;
+    // 别名只在本次连接内有效
+    mqtt_topic_alias_reset(&client_ctx->tx_aliases,
+        mqtt_properties_has(props, MQTT_PROP_TOPIC_ALIAS_MAXIMUM) ? props->topic_alias_maximum : 0);
+    mqtt_topic_alias_reset(&client_ctx->rx_aliases,
+        props ? client_ctx->connect_options.v5.topic_alias_maximum : 0);
+}
+
+// 解码收到的 PUBLISH, MQTT 5.0 下登记或解析主题别名
+// header_only 时只解码到属性为止, 返回值与对应的解码函数相同
+static int decode_incoming_publish(const uint8_t *buf, int len, mqtt_message_t *message,
+                                   bool header_only) {
+    if (!is_v5()) {
+        return header_only ? mqtt_decode_publish_header(buf, len, message)
+                           : mqtt_decode_publish(buf, len, message);
+    }
+
+    mqtt_properties_t props;
+    int pos = header_only ? mqtt_decode_publish_header_v5(buf, len, message, &props)
+                          : mqtt_decode_publish_v5(buf, len, message, &props);
+    if (pos < 0 || !mqtt_properties_has(&props, MQTT_PROP_TOPIC_ALIAS)) {
+        return pos;
+    }
+
+    // 别名对应关系丢失后, 之后只带别名的 PUBLISH 都无法交付, 断开重连由服务端重发
+    if (message->topic_len > 0) {
+        if (!mqtt_topic_alias_set(&client_ctx->rx_aliases, props.topic_alias,
+                                  message->topic, message->topic_len)) {
+            ESP_LOGE(TAG, "Cannot store topic alias %u (%u bytes)",
+                     props.topic_alias, message->topic_len);
+            client_ctx->rx_protocol_error = true;
             return -1;
         }
-        if (ret == 0) {
-            ESP_LOGE(TAG, "Connection closed by peer");
+    } else {
+        message->topic = mqtt_topic_alias_resolve(&client_ctx->rx_aliases, props.topic_alias,
+                                                  &message->topic_len);
+        if (message->topic == NULL) {
+            ESP_LOGE(TAG, "Unknown topic alias %u", props.topic_alias);
+            client_ctx->rx_protocol_error = true;
             return -1;
         }
-        received += ret;
     }
-    return received;
+    return pos;
+}
+
+// PUBLISH 加入批次: 头部编码到发送缓冲区, 大载荷直接引用调用者缓冲区
+// MQTT 5.0 下主题已有别名时只发送别名, 否则分配别名并随主题一起发送
+// MQTT 3.1.1 下有模板时按模板编码头部, MQTT 5.0 下 content_type 不为 NULL 时随包发送
+static esp_err_t tx_append_publish(const mqtt_message_t *message, uint16_t packet_id,
+                                   const mqtt_publish_template_t *prepared,
+                                   const char *content_type) {
+    mqtt_tx_batch_t *batch = &client_ctx->tx_batch;
+    mqtt_properties_t props = {0};
+    mqtt_message_t aliased;
+    // 主题长度只计算一次, 编码时不再 strlen
+    mqtt_message_t sized = *message;
+    const mqtt_message_t *encoded = &sized;
+    uint16_t topic_len = message->topic_len ? message->topic_len : strlen(message->topic);
+    uint16_t new_alias = 0;
+
+    sized.topic_len = topic_len;
+    if (is_v5()) {
+        uint16_t alias = mqtt_topic_alias_find(&client_ctx->tx_aliases, message->topic, topic_len);
+        if (alias) {
+            aliased = sized;
+            aliased.topic = "";
+            aliased.topic_len = 0;
+            encoded = &aliased;
+        } else {
+            alias = new_alias = mqtt_topic_alias_victim(&client_ctx->tx_aliases, topic_len);
+        }
+        if (alias) {
+            props.present |= MQTT_PROP_BIT(MQTT_PROP_TOPIC_ALIAS);
+            props.topic_alias = alias;
+        }
+        if (content_type) {
+            props.present |= MQTT_PROP_BIT(MQTT_PROP_CONTENT_TYPE);
+            props.content_type = content_type;
+            props.content_type_len = strlen(content_type);
+        }
+    }
+
+    // 头部和载荷最多各占一个 iovec
+    if (MQTT_TX_MAX_IOV - batch->iov_count < 2 && tx_flush() < 0) {
+        return ESP_FAIL;
+    }
+
+    while (1) {
+        uint32_t space;
+        uint8_t *dst = mqtt_tx_reserve(batch, &space);
+        int len;
+        if (is_v5()) {
+            len = mqtt_encode_publish_header_v5(encoded, packet_id, &props, dst, space);
+        } else if (prepared) {
+            len = mqtt_encode_publish_prepared(prepared, packet_id, message->dup,
+                                               message->payload_len, dst, space);
+        } else {
+            len = mqtt_encode_publish_header(encoded, packet_id, dst, space);
+        }
+        if (len > 0) {
+            if (client_ctx->server_max_packet_size > 0 &&
+                (uint32_t)len + message->payload_len > client_ctx->server_max_packet_size) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            mqtt_tx_commit(batch, len);
+            break;
+        }
+        if (!tx_make_room()) {
+            return mqtt_tx_empty(batch) ? ESP_ERR_INVALID_ARG : ESP_FAIL;
+        }
+    }
+
+    // 包已进入批次, 服务端收到后别名生效
+    if (new_alias) {
+        mqtt_topic_alias_set(&client_ctx->tx_aliases, new_alias, message->topic, topic_len);
+    }
+
+    mqtt_tx_append(batch, message->payload, message->payload_len);
+    tx_message_added();
+    return ESP_OK;
+}
+
+// 以 DUP 标志重发 PUBLISH, 已收到 PUBREC 的重发 PUBREL
+static void inflight_resend(mqtt_inflight_entry_t *entry, int64_t now_us) {
+    if (entry->state == MQTT_INFLIGHT_WAIT_PUBCOMP) {
+        tx_append_ack(MQTT_PUBREL, entry->packet_id);
+    } else {
+        mqtt_message_t message = entry->message;
+        message.dup = true;
+        tx_append_publish(&message, entry->packet_id, NULL, entry->content_type);
+    }
+    mqtt_inflight_touch(&client_ctx->inflight, entry, now_us);
+}
+
+// 重连后立即重发所有未确认的消息, 不等待重传间隔
+// 会话未保留时服务端已忘记 QoS 2 状态, 已收到 PUBREC 的消息视为送达
+static void inflight_replay(bool resumed) {
+    int64_t now_us = esp_timer_get_time();
+    uint16_t count = mqtt_inflight_count(&client_ctx->inflight);
+
+    // 每次重发都把条目移到队尾, 按原顺序恰好遍历一遍
+    for (uint16_t i = 0; i < count; i++) {
+        mqtt_inflight_entry_t *entry = mqtt_inflight_oldest(&client_ctx->inflight);
+        if (!resumed && entry->state == MQTT_INFLIGHT_WAIT_PUBCOMP) {
+            inflight_complete(entry, ESP_OK);
+            continue;
+        }
+        inflight_resend(entry, now_us);
+    }
+    if (count > 0) {
+        ESP_LOGI(TAG, "Replayed %u unacknowledged messages", count);
+    }
+}
+
+// SUBACK 中每个过滤器的结果通知给调用者, qos 为授予的 QoS
+static void notify_subscription(const mqtt_subscription_t *sub, void *arg) {
+    if (sub->state == MQTT_SUBSCRIPTION_FAILED) {
+        ESP_LOGW(TAG, "Subscription to %s rejected: 0x%02x", sub->topic, sub->granted_qos);
+    }
+    if (client_ctx->callback == NULL) {
+        return;
+    }
+
+    mqtt_message_t message = {
+        .topic = sub->topic,
+        .topic_len = sub->topic_len,
+        .qos = sub->granted_qos
+    };
+    client_ctx->callback(sub->state == MQTT_SUBSCRIPTION_ACTIVE ? MQTT_EVENT_SUBSCRIBED
+                                                                : MQTT_EVENT_SUBSCRIBE_FAILED,
+                         &message, client_ctx->callback_arg);
 }
 
 // 处理接收到的 MQTT 包
@@ -104,48 +541,117 @@ static void handle_mqtt_packet(const uint8_t *buf, int len) {
     switch (header.type) {
         case MQTT_CONNACK: {
             uint8_t session_present, return_code;
-            if (mqtt_decode_connack(buf, len, &session_present, &return_code) < 0) {
+            mqtt_properties_t props;
+            int ret = is_v5() ? mqtt_decode_connack_v5(buf, len, &session_present, &return_code, &props)
+                              : mqtt_decode_connack(buf, len, &session_present, &return_code);
+            if (ret < 0) {
                 ESP_LOGE(TAG, "Failed to decode CONNACK");
                 return;
             }
             if (return_code == 0) {
-                client_ctx->state = MQTT_STATE_CONNECTED;
+                // 服务端保留了会话时订阅仍然有效, 不需要重新订阅
+                bool resumed = session_present && !client_ctx->connect_options.clean_session;
+                ESP_LOGI(TAG, "Connected, session %s", resumed ? "resumed" : "new");
+                apply_connack_properties(is_v5() ? &props : NULL);
+                if (!resumed) {
+                    mqtt_subscriptions_resubscribe_all(&client_ctx->subscriptions);
+                    client_ctx->inbound_qos2_count = 0;
+                }
+                client_ctx->last_tx_us = esp_timer_get_time();
+                client_ctx->ping_outstanding = false;
+                set_state(MQTT_STATE_CONNECTED);
+                inflight_replay(resumed);
                 if (client_ctx->callback) {
                     client_ctx->callback(MQTT_EVENT_CONNECTED, NULL, client_ctx->callback_arg);
                 }
             } else {
                 ESP_LOGE(TAG, "Connection refused: %d", return_code);
-                client_ctx->state = MQTT_STATE_DISCONNECTED;
+                set_state(MQTT_STATE_DISCONNECTED);
             }
             break;
         }
         
         case MQTT_PUBLISH: {
             mqtt_message_t message;
-            if (mqtt_decode_publish(buf, len, &message) < 0) {
+            if (decode_incoming_publish(buf, len, &message, false) < 0) {
                 ESP_LOGE(TAG, "Failed to decode PUBLISH");
                 return;
             }
-            if (client_ctx->callback) {
+            // QoS 2 重复的 PUBLISH 只回复 PUBREC, 不再交付
+            bool deliver = message.qos != MQTT_QOS_2 || inbound_qos2_mark(message.packet_id);
+            if (client_ctx->rx_protocol_error) {
+                return;
+            }
+            // message 指向接收缓冲区, 仅在回调期间有效
+            if (deliver && client_ctx->callback) {
                 client_ctx->callback(MQTT_EVENT_MESSAGE, &message, client_ctx->callback_arg);
             }
-            // 释放解码时分配的内存
-            free((void *)message.topic);
-            free((void *)message.payload);
+            if (message.qos == MQTT_QOS_1) {
+                tx_append_ack(MQTT_PUBACK, message.packet_id);
+            } else if (message.qos == MQTT_QOS_2) {
+                tx_append_ack(MQTT_PUBREC, message.packet_id);
+            }
             break;
         }
         
         case MQTT_PUBACK:
         case MQTT_PUBREC:
         case MQTT_PUBREL:
-        case MQTT_PUBCOMP:
-        case MQTT_SUBACK:
-        case MQTT_UNSUBACK:
-            // 处理确认消息
+        case MQTT_PUBCOMP: {
+            mqtt_packet_type_t type;
+            uint16_t packet_id;
+            if (mqtt_decode_ack(buf, len, &type, &packet_id) < 0) {
+                ESP_LOGE(TAG, "Failed to decode ack type %d", header.type);
+                return;
+            }
+            if (type == MQTT_PUBREL) {
+                inbound_qos2_release(packet_id);
+                tx_append_ack(MQTT_PUBCOMP, packet_id);
+            } else {
+                handle_publish_ack(type, packet_id);
+            }
+            break;
+        }
+
+        case MQTT_SUBACK: {
+            uint16_t packet_id;
+            uint8_t codes[MQTT_SUBSCRIBE_MAX_FILTERS];
+            int count = MQTT_SUBSCRIBE_MAX_FILTERS;
+            int ret = is_v5() ? mqtt_decode_suback_v5(buf, len, &packet_id, codes, &count)
+                              : mqtt_decode_suback(buf, len, &packet_id, codes, &count);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to decode SUBACK");
+                return;
+            }
+            // 标识符可能已分配给发送中的 PUBLISH, 只归还确实由 SUBSCRIBE 占用的
+            if (!control_pending_take(MQTT_SUBSCRIBE, packet_id)) {
+                ESP_LOGW(TAG, "Unexpected SUBACK %u", packet_id);
+                break;
+            }
+            mqtt_subscriptions_ack(&client_ctx->subscriptions, packet_id, codes, count,
+                                   notify_subscription, NULL);
+            release_packet_id(packet_id);
+            break;
+        }
+
+        case MQTT_UNSUBACK: {
+            // 只需要开头的报文标识符
+            mqtt_packet_type_t type;
+            uint16_t packet_id;
+            if (mqtt_decode_ack(buf, len, &type, &packet_id) < 0) {
+                ESP_LOGE(TAG, "Failed to decode ack type %d", header.type);
+                return;
+            }
+            if (!control_pending_take(MQTT_UNSUBSCRIBE, packet_id)) {
+                ESP_LOGW(TAG, "Unexpected UNSUBACK %u", packet_id);
+                break;
+            }
+            release_packet_id(packet_id);
             break;
+        }
             
         case MQTT_PINGRESP:
-            // 处理 PING 响应
+            client_ctx->ping_outstanding = false;
             break;
             
         default:
@@ -154,82 +660,550 @@ static void handle_mqtt_packet(const uint8_t *buf, int len) {
     }
 }
 
+// 大包第一个片段: 解码 PUBLISH 头部并交付载荷开头
+static void handle_stream_begin(const uint8_t *buf, uint32_t len) {
+    const mqtt_stream_handler_t *handler = &client_ctx->stream_handler;
+    mqtt_message_t message;
+
+    client_ctx->rx_stream.active = true;
+    client_ctx->rx_stream.discard = true;
+    client_ctx->rx_stream.offset = 0;
+    client_ctx->rx_stream.qos = MQTT_QOS_0;
+
+    int pos = decode_incoming_publish(buf, len, &message, true);
+    if (pos < 0) {
+        ESP_LOGW(TAG, "Dropping oversized packet (%u bytes)", (unsigned)client_ctx->framer.packet_len);
+        return;
+    }
+    // 载荷全部收到后再确认
+    client_ctx->rx_stream.qos = message.qos;
+    client_ctx->rx_stream.packet_id = message.packet_id;
+    if (message.qos == MQTT_QOS_2 && !inbound_qos2_mark(message.packet_id)) {
+        return;
+    }
+    if (handler->begin == NULL) {
+        ESP_LOGW(TAG, "No stream handler, dropping %u byte payload", (unsigned)message.payload_len);
+        return;
+    }
+
+    client_ctx->rx_stream.discard = false;
+    handler->begin(&message, message.payload_len, handler->arg);
+    if ((uint32_t)pos < len && handler->chunk) {
+        handler->chunk(buf + pos, len - pos, 0, handler->arg);
+    }
+    client_ctx->rx_stream.offset = len - pos;
+}
+
+// 大包后续片段
+static void handle_stream_chunk(const uint8_t *data, uint32_t len, bool last) {
+    const mqtt_stream_handler_t *handler = &client_ctx->stream_handler;
+
+    if (!client_ctx->rx_stream.discard) {
+        if (handler->chunk) {
+            handler->chunk(data, len, client_ctx->rx_stream.offset, handler->arg);
+        }
+        if (last && handler->end) {
+            handler->end(true, handler->arg);
+        }
+    }
+    client_ctx->rx_stream.offset += len;
+    if (last) {
+        client_ctx->rx_stream.active = false;
+        if (client_ctx->rx_stream.qos == MQTT_QOS_1) {
+            tx_append_ack(MQTT_PUBACK, client_ctx->rx_stream.packet_id);
+        } else if (client_ctx->rx_stream.qos == MQTT_QOS_2) {
+            tx_append_ack(MQTT_PUBREC, client_ctx->rx_stream.packet_id);
+        }
+    }
+}
+
+// 连接断开时终止未完成的流
+static void abort_rx_stream(void) {
+    const mqtt_stream_handler_t *handler = &client_ctx->stream_handler;
+
+    if (client_ctx->rx_stream.active && !client_ctx->rx_stream.discard && handler->end) {
+        handler->end(false, handler->arg);
+    }
+    client_ctx->rx_stream.active = false;
+}
+
+// 接收并处理本次 recv 中包含的所有完整包和大包片段
+static int mqtt_process_incoming(void) {
+    if (mqtt_receive() < 0) {
+        return -1;
+    }
+    // 收到任何数据都说明连接仍然存活
+    client_ctx->ping_outstanding = false;
+
+    const uint8_t *packet;
+    uint32_t packet_len;
+    int ret;
+    while ((ret = mqtt_framer_next(&client_ctx->framer, &packet, &packet_len)) > 0) {
+        switch (ret) {
+            case MQTT_FRAMER_PACKET:
+                handle_mqtt_packet(packet, packet_len);
+                break;
+            case MQTT_FRAMER_STREAM_BEGIN:
+                handle_stream_begin(packet, packet_len);
+                break;
+            case MQTT_FRAMER_STREAM_CHUNK:
+                handle_stream_chunk(packet, packet_len, false);
+                break;
+            case MQTT_FRAMER_STREAM_END:
+                handle_stream_chunk(packet, packet_len, true);
+                break;
+        }
+        if (client_ctx->rx_protocol_error) {
+            client_ctx->rx_protocol_error = false;
+            return -1;
+        }
+    }
+
+    if (ret == MQTT_FRAMER_ERR_MALFORMED) {
+        ESP_LOGE(TAG, "Malformed remaining length");
+        return -1;
+    }
+    return 0;
+}
+
+// QoS 1/2 PUBLISH 登记到发送中存储后加入批次, 确认到达后才通知调用者
+static void send_reliable_publish(const mqtt_message_t *message,
+                                  const mqtt_publish_template_t *prepared,
+                                  const char *content_type,
+                                  mqtt_publish_done_t done, void *done_arg) {
+    uint16_t packet_id = get_next_packet_id();
+    if (packet_id == 0) {
+        if (done) {
+            done(ESP_ERR_NO_MEM, done_arg);
+        }
+        return;
+    }
+    mqtt_inflight_state_t state = message->qos == MQTT_QOS_1 ?
+                                  MQTT_INFLIGHT_WAIT_PUBACK : MQTT_INFLIGHT_WAIT_PUBREC;
+    mqtt_inflight_entry_t *entry = mqtt_inflight_add(&client_ctx->inflight, packet_id,
+                                                     state, esp_timer_get_time());
+    if (entry == NULL) {
+        release_packet_id(packet_id);
+        if (done) {
+            done(ESP_ERR_NO_MEM, done_arg);
+        }
+        return;
+    }
+    entry->message = *message;
+    entry->content_type = content_type;
+    entry->done = done;
+    entry->done_arg = done_arg;
+
+    esp_err_t err = tx_append_publish(message, packet_id, prepared, content_type);
+    if (err != ESP_OK) {
+        inflight_complete(entry, err);
+    }
+}
+
+// 缩短 select 等待时间, wait_us 为 -1 表示无限等待
+static void wait_at_most(int64_t *wait_us, int64_t candidate_us) {
+    if (candidate_us < 0) {
+        candidate_us = 0;
+    }
+    if (*wait_us < 0 || candidate_us < *wait_us) {
+        *wait_us = candidate_us;
+    }
+}
+
+// 重传超过 retry_interval_ms 未确认的消息, 返回距下一次重传的微秒数, 无需重传返回 -1
+static int64_t inflight_retransmit(int64_t now_us) {
+    const mqtt_qos_config_t *config = &client_ctx->qos_config;
+    int64_t interval_us = (int64_t)config->retry_interval_ms * 1000;
+    mqtt_inflight_entry_t *entry;
+
+    // MQTT 5.0 只允许在重连时重发 (MQTT-4.4.0-1), 由 CONNACK 后的 inflight_replay 负责
+    if (interval_us == 0 || is_v5()) {
+        return -1;
+    }
+
+    // FIFO 按最后发送时间排序, 只需检查队头
+    while ((entry = mqtt_inflight_oldest(&client_ctx->inflight)) != NULL) {
+        int64_t due_us = entry->last_send_us + interval_us;
+        if (due_us > now_us) {
+            return due_us - now_us;
+        }
+
+        if (config->max_retries > 0 && entry->retries >= config->max_retries) {
+            ESP_LOGW(TAG, "Packet %u unacknowledged after %u retries",
+                     entry->packet_id, entry->retries);
+            inflight_complete(entry, ESP_ERR_TIMEOUT);
+            continue;
+        }
+
+        entry->retries++;
+        inflight_resend(entry, now_us);
+    }
+    return -1;
+}
+
+// 保活: 只有在一个保活周期内没有写出任何数据时才发送 PINGREQ,
+// 之后 PINGRESP 超时即判定连接半开. 返回 -1 表示连接已失效
+static int keepalive_poll(int64_t now_us, int64_t *wait_us) {
+    int64_t interval_us = (int64_t)client_ctx->connect_options.keep_alive * 1000000;
+    if (interval_us == 0) {
+        return 0;
+    }
+
+    if (client_ctx->ping_outstanding) {
+        if (now_us >= client_ctx->ping_deadline_us) {
+            ESP_LOGE(TAG, "PINGRESP timeout");
+            return -1;
+        }
+        wait_at_most(wait_us, client_ctx->ping_deadline_us - now_us);
+        return 0;
+    }
+
+    // 批次中还有待写出的数据时不需要 PINGREQ
+    int64_t idle_us = now_us - client_ctx->last_tx_us;
+    if (idle_us < interval_us || !mqtt_tx_empty(&client_ctx->tx_batch)) {
+        wait_at_most(wait_us, interval_us - idle_us);
+        return 0;
+    }
+
+    uint32_t space;
+    uint8_t *dst = mqtt_tx_reserve(&client_ctx->tx_batch, &space);
+    int len = mqtt_encode_simple_packet(MQTT_PINGREQ, dst, space);
+    if (len < 0) {
+        return -1;
+    }
+    mqtt_tx_commit(&client_ctx->tx_batch, len);
+    tx_message_added();
+
+    int64_t timeout_us = (int64_t)MQTT_PINGRESP_TIMEOUT_MS * 1000;
+    if (timeout_us > interval_us) {
+        timeout_us = interval_us;
+    }
+    client_ctx->ping_outstanding = true;
+    client_ctx->ping_deadline_us = now_us + timeout_us;
+    wait_at_most(wait_us, timeout_us);
+    return 0;
+}
+
+// 压缩后的载荷, 发布完成时与包装的回调一起释放
+typedef struct {
+    mqtt_publish_done_t done;
+    void *done_arg;
+    uint8_t data[];
+} compressed_payload_t;
+
+static void compressed_payload_done(esp_err_t result, void *arg) {
+    compressed_payload_t *owned = arg;
+    if (owned->done) {
+        owned->done(result, owned->done_arg);
+    }
+    free(owned);
+}
+
+// 主题匹配压缩规则时改写载荷, 新载荷由包装后的 done 释放
+// MQTT 3.1.1 下即使不压缩也要加标记字节, 内存不足时只能放弃发布
+static esp_err_t publish_compress(mqtt_message_t *message, const char **content_type,
+                                  mqtt_publish_done_t *done, void **done_arg) {
+    uint16_t topic_len = message->topic_len ? message->topic_len : strlen(message->topic);
+    const mqtt_compress_entry_t *rule = mqtt_compress_match(&client_ctx->compress,
+                                                            message->topic, topic_len);
+    if (rule == NULL) {
+        return ESP_OK;
+    }
+
+    bool try_deflate = message->payload_len > 1 && message->payload_len >= rule->min_size;
+    uint32_t marker = is_v5() ? 0 : 1;
+    if (marker == 0 && !try_deflate) {
+        return ESP_OK;
+    }
+
+    compressed_payload_t *owned = malloc(sizeof(compressed_payload_t) + marker +
+                                         message->payload_len);
+    if (owned == NULL) {
+        return marker ? ESP_ERR_NO_MEM : ESP_OK;
+    }
+
+    // 容量比原始载荷少一个字节, 放得下才说明压缩划算
+    uint32_t out_len = message->payload_len - 1;
+    if (try_deflate &&
+        mqtt_compress_deflate(&client_ctx->compress, rule, message->payload,
+                              message->payload_len, owned->data + marker, &out_len) == ESP_OK) {
+        if (marker) {
+            owned->data[0] = MQTT_COMPRESS_HEADER_DEFLATE;
+        } else {
+            *content_type = rule->content_type;
+        }
+        message->payload_len = marker + out_len;
+    } else if (marker) {
+        owned->data[0] = MQTT_COMPRESS_HEADER_RAW;
+        if (message->payload_len > 0) {
+            memcpy(owned->data + 1, message->payload, message->payload_len);
+        }
+        message->payload_len += 1;
+    } else {
+        free(owned);
+        return ESP_OK;
+    }
+
+    message->payload = owned->data;
+    owned->done = *done;
+    owned->done_arg = *done_arg;
+    *done = compressed_payload_done;
+    *done_arg = owned;
+    return ESP_OK;
+}
+
+// 发送窗口已满时 QoS 1/2 PUBLISH 留在队列中
+// 窗口取本地配置与服务端 Receive Maximum 的较小值
+// 等待确认的 SUBSCRIBE / UNSUBSCRIBE 记录已满时 UNSUBSCRIBE 留在队列中
+static bool outgoing_blocked(const mqtt_internal_message_t *msg) {
+    if (msg->type == MQTT_UNSUBSCRIBE) {
+        return control_pending_full();
+    }
+
+    uint16_t window = client_ctx->qos_config.receive_maximum;
+    if (client_ctx->server_receive_maximum < window) {
+        window = client_ctx->server_receive_maximum;
+    }
+    return msg->type == MQTT_PUBLISH &&
+           msg->data.publish.message.qos != MQTT_QOS_0 &&
+           mqtt_inflight_count(&client_ctx->inflight) >= window;
+}
+
+// 处理一条待发送的消息, 编码后加入发送批次
+static void handle_outgoing(const mqtt_internal_message_t *msg) {
+    mqtt_tx_batch_t *batch = &client_ctx->tx_batch;
+    uint32_t space;
+    uint8_t *dst;
+    int len;
+
+    // 每条消息最多占用一个完成回调槽位
+    if (client_ctx->tx_messages >= MQTT_TX_MAX_MESSAGES) {
+        tx_flush();
+    }
+
+    switch (msg->type) {
+        case MQTT_PUBLISH: {
+            mqtt_message_t message = msg->data.publish.message;
+            mqtt_publish_done_t done = msg->data.publish.done;
+            void *done_arg = msg->data.publish.done_arg;
+            const char *content_type = NULL;
+            esp_err_t err = publish_compress(&message, &content_type, &done, &done_arg);
+            if (err != ESP_OK) {
+                if (done) {
+                    done(err, done_arg);
+                }
+                break;
+            }
+
+            if (message.qos != MQTT_QOS_0) {
+                send_reliable_publish(&message, msg->data.publish.prepared, content_type,
+                                      done, done_arg);
+                break;
+            }
+            err = tx_append_publish(&message, 0, msg->data.publish.prepared, content_type);
+            if (done) {
+                if (err == ESP_OK) {
+                    // 批次写出后再通知
+                    client_ctx->tx_done[client_ctx->tx_done_count].done = done;
+                    client_ctx->tx_done[client_ctx->tx_done_count].arg = done_arg;
+                    client_ctx->tx_done_count++;
+                } else {
+                    done(err, done_arg);
+                }
+            }
+            break;
+        }
+        
+        case MQTT_SUBSCRIBE:
+            // 只登记, 由 subscriptions_flush 合并发送
+            if (mqtt_subscriptions_add(&client_ctx->subscriptions, msg->data.subscribe.topic,
+                                       msg->data.subscribe.qos) != ESP_OK) {
+                ESP_LOGE(TAG, "Subscription table full");
+            }
+            break;
+        
+        case MQTT_UNSUBSCRIBE: {
+            const char *topics[] = {msg->data.unsubscribe.topic};
+            mqtt_subscriptions_remove(&client_ctx->subscriptions, msg->data.unsubscribe.topic);
+            uint16_t packet_id = get_next_packet_id();
+            if (packet_id == 0) {
+                ESP_LOGE(TAG, "No free packet id for UNSUBSCRIBE");
+                free(msg->data.unsubscribe.topic);
+                break;
+            }
+            do {
+                dst = mqtt_tx_reserve(batch, &space);
+                len = is_v5() ? mqtt_encode_unsubscribe_v5(packet_id, topics, 1, dst, space)
+                              : mqtt_encode_unsubscribe(packet_id, topics, 1, dst, space);
+            } while (len < 0 && tx_make_room());
+            if (len > 0) {
+                mqtt_tx_commit(batch, len);
+                tx_message_added();
+                control_pending_add(MQTT_UNSUBSCRIBE, packet_id);
+            } else {
+                release_packet_id(packet_id);
+            }
+            free(msg->data.unsubscribe.topic);
+            break;
+        }
+        
+        default:
+            break;
+    }
+}
+
+// 把登记表中待发送的过滤器尽量多地合并进每个 SUBSCRIBE, 连续发出不等待 SUBACK
+static void subscriptions_flush(void) {
+    mqtt_subscriptions_t *subs = &client_ctx->subscriptions;
+    mqtt_tx_batch_t *batch = &client_ctx->tx_batch;
+    mqtt_topic_filter_t filters[MQTT_SUBSCRIBE_MAX_FILTERS];
+
+    // 等待 SUBACK 的包过多时等确认到达后再继续
+    while (subs->pending > 0 && !control_pending_full()) {
+        if (client_ctx->tx_messages >= MQTT_TX_MAX_MESSAGES && tx_flush() < 0) {
+            return;
+        }
+        uint16_t packet_id = get_next_packet_id();
+        if (packet_id == 0) {
+            // SUBACK 释放标识符后再继续
+            return;
+        }
+
+        uint32_t space;
+        uint8_t *dst = mqtt_tx_reserve(batch, &space);
+        // 固定头部 + 最长剩余长度 + 报文标识符 + MQTT 5.0 属性长度
+        uint32_t overhead = 1 + 4 + 2 + (is_v5() ? 1 : 0);
+        uint32_t limit = space;
+        if (client_ctx->server_max_packet_size > 0 && client_ctx->server_max_packet_size < limit) {
+            limit = client_ctx->server_max_packet_size;
+        }
+        int count = limit > overhead ?
+                    mqtt_subscriptions_take_batch(subs, packet_id, limit - overhead,
+                                                  filters, MQTT_SUBSCRIBE_MAX_FILTERS) : 0;
+        if (count == 0) {
+            release_packet_id(packet_id);
+            if (tx_make_room()) {
+                continue;
+            }
+            ESP_LOGE(TAG, "Subscription filter does not fit in a packet");
+            return;
+        }
+
+        int len = is_v5() ? mqtt_encode_subscribe_v5(packet_id, filters, count, dst, space)
+                          : mqtt_encode_subscribe(packet_id, filters, count, dst, space);
+        if (len < 0) {
+            mqtt_subscriptions_requeue(subs, packet_id);
+            release_packet_id(packet_id);
+            return;
+        }
+        mqtt_tx_commit(batch, len);
+        tx_message_added();
+        control_pending_add(MQTT_SUBSCRIBE, packet_id);
+        ESP_LOGD(TAG, "SUBSCRIBE %u with %d filters", packet_id, count);
+    }
+}
+
+// 连接断开或协议错误
+static void handle_connection_lost(void) {
+    // 未确认的 SUBSCRIBE / UNSUBSCRIBE 不会再被确认, 归还其报文标识符
+    for (uint8_t i = 0; i < client_ctx->control_pending_count; i++) {
+        release_packet_id(client_ctx->control_pending[i].packet_id);
+    }
+    client_ctx->control_pending_count = 0;
+    mqtt_subscriptions_requeue(&client_ctx->subscriptions, 0);
+    tx_discard();
+    abort_rx_stream();
+    mqtt_framer_reset(&client_ctx->framer);
+    set_state(MQTT_STATE_DISCONNECTED);
+    if (client_ctx->callback) {
+        client_ctx->callback(MQTT_EVENT_DISCONNECTED, NULL, client_ctx->callback_arg);
+    }
+}
+
 // MQTT 客户端任务
+// 断开时阻塞在事件组上; 连接期间阻塞在 select 上, 同时等待套接字可读和唤醒 eventfd,
+// 入队的消息立即得到处理, 空闲时不会周期性唤醒
 static void mqtt_client_task(void *arg) {
-    uint8_t buf[1024];
     mqtt_internal_message_t msg;
 
     while (1) {
+        if (client_ctx->state == MQTT_STATE_DISCONNECTED) {
+            xEventGroupWaitBits(client_ctx->event_group, MQTT_ACTIVE_BIT,
+                              pdFALSE, pdFALSE, portMAX_DELAY);
+            continue;
+        }
+
+        // 取出所有排队的消息合并发送, 达到批次上限时立即写出
         if (client_ctx->state == MQTT_STATE_CONNECTED) {
-            // 检查消息队列
-            if (xQueueReceive(client_ctx->msg_queue, &msg, 0) == pdTRUE) {
-                switch (msg.type) {
-                    case MQTT_PUBLISH: {
-                        uint16_t packet_id = get_next_packet_id();
-                        int len = mqtt_encode_publish(&msg.data.publish, packet_id, buf, sizeof(buf));
-                        if (len > 0) {
-                            mqtt_send_packet(buf, len);
-                        }
-                        break;
-                    }
-                    
-                    case MQTT_SUBSCRIBE: {
-                        mqtt_topic_filter_t filter = {
-                            .topic = msg.data.subscribe.topic,
-                            .qos = msg.data.subscribe.qos
-                        };
-                        uint16_t packet_id = get_next_packet_id();
-                        int len = mqtt_encode_subscribe(packet_id, &filter, 1, buf, sizeof(buf));
-                        if (len > 0) {
-                            mqtt_send_packet(buf, len);
-                        }
-                        break;
-                    }
-                    
-                    case MQTT_UNSUBSCRIBE: {
-                        const char *topics[] = {msg.data.unsubscribe.topic};
-                        uint16_t packet_id = get_next_packet_id();
-                        int len = mqtt_encode_unsubscribe(packet_id, topics, 1, buf, sizeof(buf));
-                        if (len > 0) {
-                            mqtt_send_packet(buf, len);
-                        }
-                        break;
-                    }
-                    
-                    default:
-                        break;
+            while (xQueuePeek(client_ctx->msg_queue, &msg, 0) == pdTRUE && !outgoing_blocked(&msg)) {
+                xQueueReceive(client_ctx->msg_queue, &msg, 0);
+                handle_outgoing(&msg);
+                if (tx_batch_full() && tx_flush() < 0) {
+                    break;
                 }
             }
+            subscriptions_flush();
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        int64_t wait_us = -1;
+        if (client_ctx->state == MQTT_STATE_CONNECTED) {
+            wait_us = inflight_retransmit(now_us);
+            if (keepalive_poll(now_us, &wait_us) < 0) {
+                handle_connection_lost();
+                continue;
+            }
+        }
 
-            // 接收数据
-            fd_set readfds;
-            struct timeval tv = {
-                .tv_sec = 1,
-                .tv_usec = 0
-            };
-
-            FD_ZERO(&readfds);
-            FD_SET(client_ctx->socket, &readfds);
-
-            int ret = select(client_ctx->socket + 1, &readfds, NULL, NULL, &tv);
-            if (ret > 0) {
-                if (FD_ISSET(client_ctx->socket, &readfds)) {
-                    int len = mqtt_receive_packet(buf, sizeof(buf));
-                    if (len > 0) {
-                        handle_mqtt_packet(buf, len);
-                    } else {
-                        // 连接断开
-                        client_ctx->state = MQTT_STATE_DISCONNECTED;
-                        if (client_ctx->callback) {
-                            client_ctx->callback(MQTT_EVENT_DISCONNECTED, NULL, 
-                                              client_ctx->callback_arg);
-                        }
-                    }
+        // 队列已空: 批次等待超过 flush_deadline_us 时写出, 否则等到截止时间
+        if (!mqtt_tx_empty(&client_ctx->tx_batch)) {
+            int64_t age = now_us - client_ctx->tx_first_us;
+            int64_t remaining = (int64_t)client_ctx->flush_policy.flush_deadline_us - age;
+            if (remaining <= 0) {
+                if (tx_flush() < 0) {
+                    handle_connection_lost();
+                    continue;
                 }
+            } else {
+                wait_at_most(&wait_us, remaining);
+            }
+        }
+
+        struct timeval tv;
+        struct timeval *timeout = NULL;
+        if (wait_us >= 0) {
+            tv.tv_sec = wait_us / 1000000;
+            tv.tv_usec = wait_us % 1000000;
+            timeout = &tv;
+        }
+
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(client_ctx->socket, &readfds);
+        FD_SET(client_ctx->wake_fd, &readfds);
+        int max_fd = client_ctx->socket > client_ctx->wake_fd ?
+                     client_ctx->socket : client_ctx->wake_fd;
+
+        int ret = select(max_fd + 1, &readfds, NULL, NULL, timeout);
+        if (ret < 0) {
+            if (errno != EINTR) {
+                ESP_LOGE(TAG, "Select failed: errno %d", errno);
+                handle_connection_lost();
+            }
+            continue;
+        }
+
+        // 先清除唤醒计数, 之后入队的消息会再次唤醒 select
+        if (FD_ISSET(client_ctx->wake_fd, &readfds)) {
+            uint64_t value;
+            read(client_ctx->wake_fd, &value, sizeof(value));
+        }
+
+        if (FD_ISSET(client_ctx->socket, &readfds)) {
+            if (mqtt_process_incoming() < 0) {
+                handle_connection_lost();
             }
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(10));
     }
 }
 
@@ -247,6 +1221,30 @@ esp_err_t mqtt_client_init(const mqtt_connect_options_t *options,
 
     // 复制连接选项
     memcpy(&client_ctx->connect_options, options, sizeof(mqtt_connect_options_t));
+    if (client_ctx->connect_options.protocol_version != MQTT_PROTOCOL_V5) {
+        client_ctx->connect_options.protocol_version = MQTT_PROTOCOL_V311;
+    }
+    // 接收别名表容量有限, 不能向服务端声明更多
+    if (client_ctx->connect_options.v5.topic_alias_maximum > MQTT_TOPIC_ALIAS_MAX) {
+        client_ctx->connect_options.v5.topic_alias_maximum = MQTT_TOPIC_ALIAS_MAX;
+    }
+    // 同理, 未声明 Receive Maximum 时服务端按 65535 发送, 超出 QoS 2 接收表的容量
+    if (client_ctx->connect_options.v5.receive_maximum == 0 ||
+        client_ctx->connect_options.v5.receive_maximum > MQTT_INBOUND_QOS2_MAX) {
+        client_ctx->connect_options.v5.receive_maximum = MQTT_INBOUND_QOS2_MAX;
+    }
+    mqtt_framer_init(&client_ctx->framer, client_ctx->rx_buf, sizeof(client_ctx->rx_buf));
+    mqtt_tx_init(&client_ctx->tx_batch, client_ctx->tx_buf, sizeof(client_ctx->tx_buf));
+    client_ctx->flush_policy.max_bytes = MQTT_TX_BUFFER_SIZE;
+    client_ctx->flush_policy.max_messages = MQTT_TX_MAX_MESSAGES;
+    client_ctx->flush_policy.flush_deadline_us = 0;
+    mqtt_inflight_init(&client_ctx->inflight);
+    mqtt_subscriptions_init(&client_ctx->subscriptions);
+    mqtt_compress_init(&client_ctx->compress);
+    apply_connack_properties(NULL);
+    client_ctx->qos_config.receive_maximum = MQTT_INFLIGHT_MAX;
+    client_ctx->qos_config.retry_interval_ms = MQTT_DEFAULT_RETRY_INTERVAL_MS;
+    client_ctx->qos_config.max_retries = 0;
     
     // 创建消息队列
     client_ctx->msg_queue = xQueueCreate(MQTT_QUEUE_SIZE, 
@@ -264,9 +1262,29 @@ esp_err_t mqtt_client_init(const mqtt_connect_options_t *options,
         return ESP_ERR_NO_MEM;
     }
 
+    // 创建唤醒 eventfd, 与套接字一起由 select 等待
+    esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    esp_err_t err = esp_vfs_eventfd_register(&eventfd_config);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        vEventGroupDelete(client_ctx->event_group);
+        vQueueDelete(client_ctx->msg_queue);
+        free(client_ctx);
+        client_ctx = NULL;
+        return err;
+    }
+    client_ctx->wake_fd = eventfd(0, 0);
+    if (client_ctx->wake_fd < 0) {
+        vEventGroupDelete(client_ctx->event_group);
+        vQueueDelete(client_ctx->msg_queue);
+        free(client_ctx);
+        client_ctx = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
     client_ctx->callback = callback;
     client_ctx->callback_arg = callback_arg;
-    client_ctx->next_packet_id = 0;
+    mqtt_packet_id_init(&client_ctx->packet_ids);
+    client_ctx->socket = -1;
     client_ctx->state = MQTT_STATE_DISCONNECTED;
 
     // 创建 MQTT 客户端任务
@@ -274,6 +1292,7 @@ esp_err_t mqtt_client_init(const mqtt_connect_options_t *options,
                                 MQTT_TASK_STACK_SIZE, NULL,
                                 MQTT_TASK_PRIORITY, &client_ctx->task_handle);
     if (ret != pdPASS) {
+        close(client_ctx->wake_fd);
         vEventGroupDelete(client_ctx->event_group);
         vQueueDelete(client_ctx->msg_queue);
         free(client_ctx);
@@ -281,4 +1300,163 @@ esp_err_t mqtt_client_init(const mqtt_connect_options_t *options,
     }
 
     return ESP_OK;
-} 
\ No newline at end of file
+}
+
+// 设置大包流式接收处理器
+esp_err_t mqtt_client_set_stream_handler(const mqtt_stream_handler_t *handler) {
+    if (client_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (handler) {
+        client_ctx->stream_handler = *handler;
+    } else {
+        memset(&client_ctx->stream_handler, 0, sizeof(mqtt_stream_handler_t));
+    }
+    return ESP_OK;
+}
+
+// 发布消息
+esp_err_t mqtt_client_publish(const mqtt_message_t *message,
+                             mqtt_publish_done_t done, void *done_arg) {
+    if (client_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (message == NULL || message->topic == NULL ||
+        (message->payload == NULL && message->payload_len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mqtt_internal_message_t msg = {
+        .type = MQTT_PUBLISH,
+        .data.publish = {
+            .message = *message,
+            .done = done,
+            .done_arg = done_arg
+        }
+    };
+    if (xQueueSend(client_ctx->msg_queue, &msg, 0) != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+    mqtt_client_wake();
+    return ESP_OK;
+}
+
+// 按模板发布消息
+esp_err_t mqtt_client_publish_prepared(const mqtt_publish_template_t *tpl,
+                                      const uint8_t *payload, uint32_t payload_len,
+                                      mqtt_publish_done_t done, void *done_arg) {
+    if (client_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (tpl == NULL || (payload == NULL && payload_len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // 重传和 MQTT 5.0 下按普通消息编码, 主题长度已知
+    mqtt_internal_message_t msg = {
+        .type = MQTT_PUBLISH,
+        .data.publish = {
+            .message = {
+                .topic = tpl->topic,
+                .topic_len = tpl->topic_len,
+                .payload = payload,
+                .payload_len = payload_len,
+                .qos = tpl->qos,
+                .retain = tpl->retain
+            },
+            .prepared = tpl,
+            .done = done,
+            .done_arg = done_arg
+        }
+    };
+    if (xQueueSend(client_ctx->msg_queue, &msg, 0) != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+    mqtt_client_wake();
+    return ESP_OK;
+}
+
+// 订阅/取消订阅: 复制 topic 后入队, 由客户端任务更新登记表
+static esp_err_t enqueue_subscription(mqtt_packet_type_t type, const char *topic, mqtt_qos_t qos) {
+    if (client_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (topic == NULL || topic[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // 单个过滤器必须能放进一个 SUBSCRIBE
+    if (strlen(topic) > MQTT_TX_BUFFER_SIZE - 16) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    char *copy = strdup(topic);
+    if (copy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    mqtt_internal_message_t msg = {.type = type};
+    if (type == MQTT_SUBSCRIBE) {
+        msg.data.subscribe.topic = copy;
+        msg.data.subscribe.qos = qos;
+    } else {
+        msg.data.unsubscribe.topic = copy;
+    }
+    if (xQueueSend(client_ctx->msg_queue, &msg, 0) != pdTRUE) {
+        free(copy);
+        return ESP_ERR_NO_MEM;
+    }
+    mqtt_client_wake();
+    return ESP_OK;
+}
+
+// 订阅主题
+esp_err_t mqtt_client_subscribe(const char *topic, mqtt_qos_t qos) {
+    return enqueue_subscription(MQTT_SUBSCRIBE, topic, qos);
+}
+
+// 取消订阅主题
+esp_err_t mqtt_client_unsubscribe(const char *topic) {
+    return enqueue_subscription(MQTT_UNSUBSCRIBE, topic, MQTT_QOS_0);
+}
+
+// 添加载荷压缩规则
+esp_err_t mqtt_client_add_compression_rule(const mqtt_compress_rule_t *rule) {
+    if (client_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return mqtt_compress_add_rule(&client_ctx->compress, rule);
+}
+
+// 设置发送合并策略
+esp_err_t mqtt_client_set_flush_policy(const mqtt_flush_policy_t *policy) {
+    if (client_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (policy == NULL || policy->max_bytes == 0 || policy->max_messages == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    client_ctx->flush_policy = *policy;
+    if (client_ctx->flush_policy.max_messages > MQTT_TX_MAX_MESSAGES) {
+        client_ctx->flush_policy.max_messages = MQTT_TX_MAX_MESSAGES;
+    }
+    mqtt_client_wake();
+    return ESP_OK;
+}
+
+// 设置 QoS 1/2 发送窗口和重传策略
+esp_err_t mqtt_client_set_qos_config(const mqtt_qos_config_t *config) {
+    if (client_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config == NULL || config->receive_maximum == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    client_ctx->qos_config = *config;
+    if (client_ctx->qos_config.receive_maximum > MQTT_INFLIGHT_MAX) {
+        client_ctx->qos_config.receive_maximum = MQTT_INFLIGHT_MAX;
+    }
+    mqtt_client_wake();
+    return ESP_OK;
+}
@@ -0,0 +1,82 @@
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include "mqtt_types.h"
+#include "mqtt_encoder.h"
+#include "mqtt_compress.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// MQTT 客户端事件
+typedef enum {
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_MESSAGE,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_SUBSCRIBE_FAILED
+} mqtt_event_t;
+
+// 事件回调, MQTT_EVENT_MESSAGE 时 message 仅在回调期间有效
+// MQTT_EVENT_SUBSCRIBED / MQTT_EVENT_SUBSCRIBE_FAILED 时 message->topic 为过滤器,
+// message->qos 为 SUBACK 返回码 (成功时即授予的 QoS)
+typedef void (*mqtt_callback_t)(mqtt_event_t event, const mqtt_message_t *message, void *arg);
+
+// 载荷超过接收缓冲区的 PUBLISH 以流的方式交付
+// begin 时 message->payload 为 NULL, topic 仅在 begin 期间有效, total_len 为载荷总长度
+// chunk 按顺序交付载荷片段, offset 为片段在载荷中的偏移
+// end 在载荷全部交付 (complete 为 true) 或连接中途断开 (complete 为 false) 时调用
+typedef struct {
+    void (*begin)(const mqtt_message_t *message, uint32_t total_len, void *arg);
+    void (*chunk)(const uint8_t *data, uint32_t len, uint32_t offset, void *arg);
+    void (*end)(bool complete, void *arg);
+    void *arg;
+} mqtt_stream_handler_t;
+
+// 发布完成回调: QoS 0 在头部和载荷全部写入套接字后调用,
+// QoS 1/2 在收到 PUBACK / PUBCOMP 后调用, 重传次数用尽时以 ESP_ERR_TIMEOUT 调用
+typedef void (*mqtt_publish_done_t)(esp_err_t result, void *arg);
+
+// QoS 1/2 发送配置
+typedef struct {
+    uint16_t receive_maximum;      // 同时等待确认的消息上限, 不超过 MQTT_INFLIGHT_MAX
+    uint32_t retry_interval_ms;    // 未确认时按此间隔以 DUP 标志重传, 0 表示连接期间不重传
+                                   // MQTT 5.0 连接期间从不重传, 只在重连后重发
+    uint8_t max_retries;           // 重传次数上限, 0 表示不限
+} mqtt_qos_config_t;
+
+// 发送合并策略: 排队的消息合并为一次写出
+// 批次达到 max_bytes 或 max_messages 时立即写出; 队列排空后批次最多再等待
+// flush_deadline_us 以合并后续消息, 0 表示排空后立即写出
+typedef struct {
+    uint32_t max_bytes;
+    uint16_t max_messages;
+    uint32_t flush_deadline_us;
+} mqtt_flush_policy_t;
+
+// MQTT 客户端API
+esp_err_t mqtt_client_init(const mqtt_connect_options_t *options,
+                          mqtt_callback_t callback, void *callback_arg);
+// 未设置时大包被丢弃
+esp_err_t mqtt_client_set_stream_handler(const mqtt_stream_handler_t *handler);
+// 载荷直接从调用者的缓冲区发送, 不受发送缓冲区大小限制
+// topic 和 payload 必须保持有效直到 done 被调用 (done 可为 NULL)
+// QoS 1/2 消息在发送窗口满时留在队列中, 直到有确认释放窗口
+esp_err_t mqtt_client_publish(const mqtt_message_t *message,
+                             mqtt_publish_done_t done, void *done_arg);
+// 订阅登记在客户端中, 与其他待订阅的过滤器合并进同一个 SUBSCRIBE 发送,
+// 断开重连后自动重新订阅. 结果通过 MQTT_EVENT_SUBSCRIBED / MQTT_EVENT_SUBSCRIBE_FAILED 通知
+esp_err_t mqtt_client_subscribe(const char *topic, mqtt_qos_t qos);
+esp_err_t mqtt_client_unsubscribe(const char *topic);
+// 按 mqtt_prepare_publish 生成的模板发布, 每条消息只写入剩余长度和报文标识符
+// tpl 和 payload 必须保持有效直到 done 被调用
+esp_err_t mqtt_client_publish_prepared(const mqtt_publish_template_t *tpl,
+                                      const uint8_t *payload, uint32_t payload_len,
+                                      mqtt_publish_done_t done, void *done_arg);
+// 匹配规则的主题在发送前压缩载荷, 在发布这些主题之前添加
+// 载荷格式见 mqtt_compress.h: MQTT 3.1.1 下接收端需要先去掉标记字节
+esp_err_t mqtt_client_add_compression_rule(const mqtt_compress_rule_t *rule);
+esp_err_t mqtt_client_set_flush_policy(const mqtt_flush_policy_t *policy);
+esp_err_t mqtt_client_set_qos_config(const mqtt_qos_config_t *config);
+
+#endif /* MQTT_CLIENT_H */
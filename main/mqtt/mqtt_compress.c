@@ -0,0 +1,83 @@
+#include "mqtt_compress.h"
+#include "mqtt_topic_filter.h"
+#include <string.h>
+
+void mqtt_compress_init(mqtt_compress_ctx_t *ctx) {
+    memset(ctx, 0, sizeof(mqtt_compress_ctx_t));
+}
+
+void mqtt_compress_deinit(mqtt_compress_ctx_t *ctx) {
+    if (ctx->stream_ready) {
+        deflateEnd(&ctx->stream);
+        ctx->stream_ready = false;
+    }
+}
+
+esp_err_t mqtt_compress_add_rule(mqtt_compress_ctx_t *ctx, const mqtt_compress_rule_t *rule) {
+    if (rule == NULL || rule->topic_filter == NULL || rule->topic_filter[0] == '\0' ||
+        strlen(rule->topic_filter) >= MQTT_COMPRESS_FILTER_LEN ||
+        (rule->dictionary == NULL && rule->dictionary_len > 0) ||
+        (rule->content_type && strlen(rule->content_type) >= MQTT_COMPRESS_CONTENT_TYPE_LEN)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ctx->rule_count >= MQTT_COMPRESS_MAX_RULES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    mqtt_compress_entry_t *entry = &ctx->rules[ctx->rule_count];
+    memset(entry, 0, sizeof(mqtt_compress_entry_t));
+    strcpy(entry->topic_filter, rule->topic_filter);
+    entry->dictionary = rule->dictionary;
+    entry->dictionary_len = rule->dictionary_len;
+    entry->min_size = rule->min_size;
+    strcpy(entry->content_type, rule->content_type ? rule->content_type
+                                                    : MQTT_COMPRESS_DEFAULT_CONTENT_TYPE);
+    // 条目填好后再计入, 匹配时不会看到半成品
+    ctx->rule_count++;
+    return ESP_OK;
+}
+
+const mqtt_compress_entry_t *mqtt_compress_match(const mqtt_compress_ctx_t *ctx,
+                                                 const char *topic, uint16_t topic_len) {
+    uint8_t count = ctx->rule_count;
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (mqtt_topic_filter_match(ctx->rules[i].topic_filter, topic, topic_len, NULL)) {
+            return &ctx->rules[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t mqtt_compress_deflate(mqtt_compress_ctx_t *ctx, const mqtt_compress_entry_t *rule,
+                                const uint8_t *in, uint32_t in_len,
+                                uint8_t *out, uint32_t *out_len) {
+    z_stream *stream = &ctx->stream;
+
+    // 压缩状态跨消息复用, 每条消息独立成流, 接收端不需要保存上下文
+    if (!ctx->stream_ready) {
+        memset(stream, 0, sizeof(z_stream));
+        if (deflateInit2(stream, MQTT_COMPRESS_LEVEL, Z_DEFLATED, MQTT_COMPRESS_WINDOW_BITS,
+                         MQTT_COMPRESS_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return ESP_ERR_NO_MEM;
+        }
+        ctx->stream_ready = true;
+    } else if (deflateReset(stream) != Z_OK) {
+        return ESP_FAIL;
+    }
+
+    if (rule->dictionary_len > 0 &&
+        deflateSetDictionary(stream, rule->dictionary, rule->dictionary_len) != Z_OK) {
+        return ESP_FAIL;
+    }
+
+    stream->next_in = (Bytef *)in;
+    stream->avail_in = in_len;
+    stream->next_out = out;
+    stream->avail_out = *out_len;
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_len = stream->total_out;
+    return ESP_OK;
+}
@@ -0,0 +1,66 @@
+#ifndef MQTT_COMPRESS_H
+#define MQTT_COMPRESS_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <zlib.h>
+
+// 按主题启用的发布载荷压缩
+// 匹配规则的主题在编码 PUBLISH 前用 zlib 格式的 deflate 压缩, 可带预共享字典:
+// 短小且重复的 JSON/CSV 遥测本身压缩效果有限, 字典让第一个字节就能引用常见的键名.
+// 压缩结果不比原始载荷短时原样发送
+// MQTT 5.0 下压缩的载荷带 Content Type 属性, 原样发送的载荷不带;
+// MQTT 3.1.1 下匹配规则的主题每个载荷前加一个标记字节, 接收端据此判断是否需要解压
+// 窗口和内存级别按嵌入式场景取小值, 压缩状态约 20KB, 第一次压缩时分配
+
+#define MQTT_COMPRESS_MAX_RULES         8
+#define MQTT_COMPRESS_FILTER_LEN        64
+#define MQTT_COMPRESS_CONTENT_TYPE_LEN  32
+#define MQTT_COMPRESS_LEVEL             6
+#define MQTT_COMPRESS_WINDOW_BITS       10     // 1KB 窗口, 接收端用默认窗口即可解压
+#define MQTT_COMPRESS_MEM_LEVEL         4
+
+// MQTT 3.1.1 标记字节
+#define MQTT_COMPRESS_HEADER_RAW        0x00
+#define MQTT_COMPRESS_HEADER_DEFLATE    0x01
+
+#define MQTT_COMPRESS_DEFAULT_CONTENT_TYPE "application/zlib"
+
+typedef struct {
+    const char *topic_filter;      // 支持 '+' 和 '#'
+    const uint8_t *dictionary;     // 预共享字典, 可为 NULL, 必须在规则有效期间保持有效
+    uint16_t dictionary_len;
+    uint16_t min_size;             // 短于此长度的载荷不尝试压缩
+    const char *content_type;      // MQTT 5.0 压缩载荷的 Content Type, NULL 使用默认值
+} mqtt_compress_rule_t;
+
+typedef struct {
+    char topic_filter[MQTT_COMPRESS_FILTER_LEN];
+    const uint8_t *dictionary;
+    uint16_t dictionary_len;
+    uint16_t min_size;
+    char content_type[MQTT_COMPRESS_CONTENT_TYPE_LEN];
+} mqtt_compress_entry_t;
+
+typedef struct {
+    mqtt_compress_entry_t rules[MQTT_COMPRESS_MAX_RULES];
+    uint8_t rule_count;
+    z_stream stream;
+    bool stream_ready;
+} mqtt_compress_ctx_t;
+
+void mqtt_compress_init(mqtt_compress_ctx_t *ctx);
+// 释放压缩状态, 规则保留
+void mqtt_compress_deinit(mqtt_compress_ctx_t *ctx);
+esp_err_t mqtt_compress_add_rule(mqtt_compress_ctx_t *ctx, const mqtt_compress_rule_t *rule);
+// 返回主题匹配的第一条规则, 没有返回 NULL
+const mqtt_compress_entry_t *mqtt_compress_match(const mqtt_compress_ctx_t *ctx,
+                                                 const char *topic, uint16_t topic_len);
+// 压缩到 out, *out_len 传入容量, 返回压缩后的长度
+// 结果放不进 out 时返回 ESP_ERR_INVALID_SIZE, 容量取原始长度减一即可判断压缩是否划算
+esp_err_t mqtt_compress_deflate(mqtt_compress_ctx_t *ctx, const mqtt_compress_entry_t *rule,
+                                const uint8_t *in, uint32_t in_len,
+                                uint8_t *out, uint32_t *out_len);
+
+#endif /* MQTT_COMPRESS_H */
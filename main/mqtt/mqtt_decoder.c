@@ -1,5 +1,7 @@
 #include "mqtt_decoder.h"
 #include "mqtt_types.h"
+#include "mqtt_properties.h"
+#include <stdlib.h>
 #include <string.h>
 
 // 解码剩余长度
@@ -23,15 +25,15 @@ static int decode_remaining_length(const uint8_t *buf, int buf_len, uint32_t *va
     return decoded;
 }
 
-// 解码字符串
-static int decode_string(const uint8_t *buf, int buf_len, char *str, int str_len) {
+// 解码字符串视图, 不复制
+static int decode_string_view(const uint8_t *buf, int buf_len, const char **str, uint16_t *str_len) {
     if (buf_len < 2) return -1;
     
     uint16_t length = (buf[0] << 8) | buf[1];
-    if (buf_len < length + 2 || str_len <= length) return -1;
+    if (buf_len < length + 2) return -1;
     
-    memcpy(str, buf + 2, length);
-    str[length] = '\0';
+    *str = (const char *)(buf + 2);
+    *str_len = length;
     
     return length + 2;
 }
@@ -70,13 +72,43 @@ int mqtt_decode_connack(const uint8_t *buf, int buf_len,
     return pos + 2;
 }
 
-// 解码 PUBLISH 包
-int mqtt_decode_publish(const uint8_t *buf, int buf_len, mqtt_message_t *message) {
+// 解码 MQTT 5.0 CONNACK 包, return_code 为原因码
+int mqtt_decode_connack_v5(const uint8_t *buf, int buf_len, uint8_t *session_present,
+                          uint8_t *return_code, mqtt_properties_t *props) {
+    if (!buf || !session_present || !return_code || !props || buf_len < 4) return -1;
+    
+    mqtt_fixed_header_t header;
+    int pos = mqtt_decode_fixed_header(buf, buf_len, &header);
+    if (pos < 0) return -1;
+    
+    if (header.type != MQTT_CONNACK || header.remaining_length < 2) return -1;
+    if ((uint32_t)(buf_len - pos) < header.remaining_length) return -1;
+    
+    int end = pos + header.remaining_length;
+    *session_present = buf[pos] & 0x01;
+    *return_code = buf[pos + 1];
+    pos += 2;
+    
+    // 属性可以省略
+    if (pos < end) {
+        int len = mqtt_properties_decode(buf + pos, end - pos, props);
+        if (len < 0) return -1;
+    } else {
+        memset(props, 0, sizeof(mqtt_properties_t));
+    }
+    
+    return end;
+}
+
+// 解码 PUBLISH 包头部, props 非 NULL 时按 MQTT 5.0 解码属性
+static int decode_publish_header(const uint8_t *buf, int buf_len, mqtt_message_t *message,
+                                 mqtt_properties_t *props) {
     if (!buf || !message || buf_len < 4) return -1;
     
     mqtt_fixed_header_t header;
     int pos = mqtt_decode_fixed_header(buf, buf_len, &header);
     if (pos < 0) return -1;
+    int header_end = pos;
     
     if (header.type != MQTT_PUBLISH) return -1;
     
@@ -84,43 +116,77 @@ int mqtt_decode_publish(const uint8_t *buf, int buf_len, mqtt_message_t *message
     message->qos = header.qos_level;
     message->retain = header.retain;
     
-    // 解码主题
-    char topic[256];
-    int topic_len = decode_string(buf + pos, buf_len - pos, topic, sizeof(topic));
+    // 解码主题, 直接引用接收缓冲区
+    int topic_len = decode_string_view(buf + pos, buf_len - pos, &message->topic, &message->topic_len);
     if (topic_len < 0) return -1;
-    message->topic = strdup(topic);
     pos += topic_len;
     
     // 处理报文标识符
-    uint16_t packet_id = 0;
+    message->packet_id = 0;
     if (message->qos > 0) {
         if (buf_len - pos < 2) return -1;
-        packet_id = (buf[pos] << 8) | buf[pos + 1];
+        message->packet_id = (buf[pos] << 8) | buf[pos + 1];
         pos += 2;
     }
     
-    // 处理载荷
-    int payload_len = header.remaining_length - topic_len;
-    if (message->qos > 0) payload_len -= 2;
-    
-    if (payload_len > 0) {
-        uint8_t *payload = malloc(payload_len);
-        if (!payload) return -1;
-        memcpy(payload, buf + pos, payload_len);
-        message->payload = payload;
-        message->payload_len = payload_len;
-    } else {
-        message->payload = NULL;
-        message->payload_len = 0;
+    if (props) {
+        int len = mqtt_properties_decode(buf + pos, buf_len - pos, props);
+        if (len < 0) return -1;
+        pos += len;
     }
     
-    return pos + payload_len;
+    // 载荷长度
+    int64_t payload_len = (int64_t)header.remaining_length - (pos - header_end);
+    if (payload_len < 0) return -1;
+    
+    message->payload = NULL;
+    message->payload_len = payload_len;
+    
+    return pos;
+}
+
+// 解码 PUBLISH 包头部, buf 只需包含到报文标识符为止
+// payload_len 为整个载荷的长度, payload 置为 NULL, 返回载荷在包内的偏移
+int mqtt_decode_publish_header(const uint8_t *buf, int buf_len, mqtt_message_t *message) {
+    return decode_publish_header(buf, buf_len, message, NULL);
+}
+
+// 解码 MQTT 5.0 PUBLISH 包头部, buf 需包含到属性为止
+// 使用主题别名时 topic_len 为 0, 别名见 props->topic_alias
+int mqtt_decode_publish_header_v5(const uint8_t *buf, int buf_len, mqtt_message_t *message,
+                                 mqtt_properties_t *props) {
+    if (!props) return -1;
+    return decode_publish_header(buf, buf_len, message, props);
+}
+
+// 解码 PUBLISH 包
+int mqtt_decode_publish(const uint8_t *buf, int buf_len, mqtt_message_t *message) {
+    int pos = mqtt_decode_publish_header(buf, buf_len, message);
+    if (pos < 0) return -1;
+    if ((uint32_t)(buf_len - pos) < message->payload_len) return -1;
+    
+    message->payload = message->payload_len > 0 ? buf + pos : NULL;
+    
+    return pos + message->payload_len;
+}
+
+// 解码 MQTT 5.0 PUBLISH 包
+int mqtt_decode_publish_v5(const uint8_t *buf, int buf_len, mqtt_message_t *message,
+                          mqtt_properties_t *props) {
+    int pos = mqtt_decode_publish_header_v5(buf, buf_len, message, props);
+    if (pos < 0) return -1;
+    if ((uint32_t)(buf_len - pos) < message->payload_len) return -1;
+    
+    message->payload = message->payload_len > 0 ? buf + pos : NULL;
+    
+    return pos + message->payload_len;
 }
 
 // 解码 SUBACK 包
-int mqtt_decode_suback(const uint8_t *buf, int buf_len, 
-                      uint16_t *packet_id, uint8_t *return_codes,
-                      int *return_code_count) {
+// v5 时返回码 (原因码) 之前有属性
+static int decode_suback(const uint8_t *buf, int buf_len, bool v5,
+                         uint16_t *packet_id, uint8_t *return_codes,
+                         int *return_code_count) {
     if (!buf || !packet_id || !return_codes || !return_code_count || 
         buf_len < 4) return -1;
     
@@ -128,15 +194,82 @@ int mqtt_decode_suback(const uint8_t *buf, int buf_len,
     int pos = mqtt_decode_fixed_header(buf, buf_len, &header);
     if (pos < 0) return -1;
     
-    if (header.type != MQTT_SUBACK) return -1;
+    if (header.type != MQTT_SUBACK || header.remaining_length < 2) return -1;
+    if ((uint32_t)(buf_len - pos) < header.remaining_length) return -1;
     
+    int end = pos + header.remaining_length;
     *packet_id = (buf[pos] << 8) | buf[pos + 1];
     pos += 2;
     
-    *return_code_count = header.remaining_length - 2;
-    if (*return_code_count <= 0) return -1;
+    if (v5) {
+        mqtt_properties_t props;
+        int len = mqtt_properties_decode(buf + pos, end - pos, &props);
+        if (len < 0) return -1;
+        pos += len;
+    }
+    
+    int count = end - pos;
+    if (count <= 0 || count > *return_code_count) return -1;
     
-    memcpy(return_codes, buf + pos, *return_code_count);
+    memcpy(return_codes, buf + pos, count);
+    *return_code_count = count;
+    
+    return end;
+}
+
+int mqtt_decode_suback(const uint8_t *buf, int buf_len, 
+                      uint16_t *packet_id, uint8_t *return_codes,
+                      int *return_code_count) {
+    return decode_suback(buf, buf_len, false, packet_id, return_codes, return_code_count);
+}
+
+int mqtt_decode_suback_v5(const uint8_t *buf, int buf_len,
+                         uint16_t *packet_id, uint8_t *reason_codes,
+                         int *reason_code_count) {
+    return decode_suback(buf, buf_len, true, packet_id, reason_codes, reason_code_count);
+}
+
+// 解码只含报文标识符的确认包 (PUBACK, PUBREC, PUBREL, PUBCOMP, UNSUBACK)
+int mqtt_decode_ack(const uint8_t *buf, int buf_len, mqtt_packet_type_t *type, uint16_t *packet_id) {
+    if (!buf || !type || !packet_id || buf_len < 4) return -1;
     
-    return pos + *return_code_count;
-} 
\ No newline at end of file
+    mqtt_fixed_header_t header;
+    int pos = mqtt_decode_fixed_header(buf, buf_len, &header);
+    if (pos < 0) return -1;
+    
+    if (header.remaining_length < 2 || buf_len - pos < 2) return -1;
+    
+    *type = header.type;
+    *packet_id = (buf[pos] << 8) | buf[pos + 1];
+    
+    return pos + header.remaining_length;
+}
+
+mqtt_message_t *mqtt_message_retain(const mqtt_message_t *view) {
+    if (!view || !view->topic) return NULL;
+    
+    uint16_t topic_len = view->topic_len ? view->topic_len : strlen(view->topic);
+    
+    // 结构体、主题和载荷放在同一次分配中
+    mqtt_message_t *copy = malloc(sizeof(mqtt_message_t) + topic_len + 1 + view->payload_len);
+    if (!copy) return NULL;
+    
+    char *topic = (char *)(copy + 1);
+    uint8_t *payload = (uint8_t *)topic + topic_len + 1;
+    memcpy(topic, view->topic, topic_len);
+    topic[topic_len] = '\0';
+    if (view->payload_len > 0) {
+        memcpy(payload, view->payload, view->payload_len);
+    }
+    
+    *copy = *view;
+    copy->topic = topic;
+    copy->topic_len = topic_len;
+    copy->payload = view->payload_len > 0 ? payload : NULL;
+    
+    return copy;
+}
+
+void mqtt_message_release(mqtt_message_t *message) {
+    free(message);
+}
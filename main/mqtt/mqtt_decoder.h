@@ -0,0 +1,40 @@
+#ifndef MQTT_DECODER_H
+#define MQTT_DECODER_H
+
+#include "mqtt_types.h"
+#include "mqtt_properties.h"
+#include <stdint.h>
+
+// MQTT 解码API, 成功返回消耗的字节数, 失败返回 -1
+int mqtt_decode_fixed_header(const uint8_t *buf, int buf_len,
+                           mqtt_fixed_header_t *header);
+int mqtt_decode_connack(const uint8_t *buf, int buf_len,
+                       uint8_t *session_present, uint8_t *return_code);
+// 零拷贝解码: message 中的 topic/payload 直接指向 buf
+int mqtt_decode_publish(const uint8_t *buf, int buf_len, mqtt_message_t *message);
+// 只解码 PUBLISH 头部, 用于载荷超过接收缓冲区的流式接收, 返回载荷偏移
+int mqtt_decode_publish_header(const uint8_t *buf, int buf_len, mqtt_message_t *message);
+// return_code_count 传入 return_codes 的容量, 返回实际的返回码个数
+int mqtt_decode_suback(const uint8_t *buf, int buf_len,
+                      uint16_t *packet_id, uint8_t *return_codes,
+                      int *return_code_count);
+// 确认包只解码报文标识符, 同样适用于 MQTT 5.0 (忽略原因码和属性)
+int mqtt_decode_ack(const uint8_t *buf, int buf_len, mqtt_packet_type_t *type, uint16_t *packet_id);
+
+// MQTT 5.0 解码, 属性中的字符串指向 buf
+int mqtt_decode_connack_v5(const uint8_t *buf, int buf_len, uint8_t *session_present,
+                          uint8_t *return_code, mqtt_properties_t *props);
+int mqtt_decode_publish_v5(const uint8_t *buf, int buf_len, mqtt_message_t *message,
+                          mqtt_properties_t *props);
+int mqtt_decode_publish_header_v5(const uint8_t *buf, int buf_len, mqtt_message_t *message,
+                                 mqtt_properties_t *props);
+// 跳过属性, 只返回每个过滤器的原因码
+int mqtt_decode_suback_v5(const uint8_t *buf, int buf_len,
+                         uint16_t *packet_id, uint8_t *reason_codes,
+                         int *reason_code_count);
+
+// 将消息视图复制为一次分配的独立副本 (topic 以 '\0' 结尾), 用 mqtt_message_release 释放
+mqtt_message_t *mqtt_message_retain(const mqtt_message_t *view);
+void mqtt_message_release(mqtt_message_t *message);
+
+#endif /* MQTT_DECODER_H */
@@ -1,5 +1,8 @@
 #include "mqtt_encoder.h"
 #include "mqtt_types.h"
+#include "mqtt_properties.h"
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 // 编码剩余长度
@@ -17,6 +20,14 @@ static int encode_remaining_length(uint32_t length, uint8_t *buf) {
     return encoded;
 }
 
+// 编码已知长度的字符串
+static int encode_string_n(const char *str, uint16_t len, uint8_t *buf) {
+    buf[0] = len >> 8;
+    buf[1] = len & 0xFF;
+    memcpy(buf + 2, str, len);
+    return len + 2;
+}
+
 // 编码字符串
 static int encode_string(const char *str, uint8_t *buf) {
     uint16_t len = strlen(str);
@@ -26,12 +37,37 @@ static int encode_string(const char *str, uint8_t *buf) {
     return len + 2;
 }
 
+// 由连接选项生成 CONNECT 属性
+static void connect_properties(const mqtt_connect_options_t *options, mqtt_properties_t *props) {
+    memset(props, 0, sizeof(mqtt_properties_t));
+    if (options->v5.session_expiry) {
+        props->present |= MQTT_PROP_BIT(MQTT_PROP_SESSION_EXPIRY);
+        props->session_expiry = options->v5.session_expiry;
+    }
+    if (options->v5.receive_maximum) {
+        props->present |= MQTT_PROP_BIT(MQTT_PROP_RECEIVE_MAXIMUM);
+        props->receive_maximum = options->v5.receive_maximum;
+    }
+    if (options->v5.maximum_packet_size) {
+        props->present |= MQTT_PROP_BIT(MQTT_PROP_MAXIMUM_PACKET_SIZE);
+        props->maximum_packet_size = options->v5.maximum_packet_size;
+    }
+    if (options->v5.topic_alias_maximum) {
+        props->present |= MQTT_PROP_BIT(MQTT_PROP_TOPIC_ALIAS_MAXIMUM);
+        props->topic_alias_maximum = options->v5.topic_alias_maximum;
+    }
+}
+
 // 编码 CONNECT 包
 int mqtt_encode_connect(const mqtt_connect_options_t *options, uint8_t *buf, int buf_len) {
     if (!options || !buf || buf_len < 10) {
         return -1;
     }
 
+    bool v5 = options->protocol_version == MQTT_PROTOCOL_V5;
+    mqtt_properties_t props;
+    connect_properties(options, &props);
+
     int pos = 0;
     
     // 固定头部
@@ -39,11 +75,17 @@ int mqtt_encode_connect(const mqtt_connect_options_t *options, uint8_t *buf, int
     
     // 计算剩余长度
     int remaining_length = 10; // 协议名长度(6) + 协议级别(1) + 连接标志(1) + 保持连接(2)
+    if (v5) {
+        remaining_length += mqtt_properties_size(&props);
+    }
     
     // 计算可变头部和载荷的长度
     remaining_length += 2 + strlen(options->client_id); // 客户端标识符
     
     if (options->will.topic && options->will.message) {
+        if (v5) {
+            remaining_length += 1; // 遗嘱属性长度 0
+        }
         remaining_length += 2 + strlen(options->will.topic);
         remaining_length += 2 + strlen(options->will.message);
     }
@@ -55,6 +97,10 @@ int mqtt_encode_connect(const mqtt_connect_options_t *options, uint8_t *buf, int
         }
     }
     
+    if (buf_len < 1 + 4 + remaining_length) {
+        return -1;
+    }
+    
     // 编码剩余长度
     pos += encode_remaining_length(remaining_length, buf + pos);
     
@@ -65,7 +111,7 @@ int mqtt_encode_connect(const mqtt_connect_options_t *options, uint8_t *buf, int
     pos += 4;
     
     // 协议级别
-    buf[pos++] = 4; // MQTT 3.1.1
+    buf[pos++] = v5 ? MQTT_PROTOCOL_V5 : MQTT_PROTOCOL_V311;
     
     // 连接标志
     uint8_t connect_flags = 0;
@@ -91,10 +137,17 @@ int mqtt_encode_connect(const mqtt_connect_options_t *options, uint8_t *buf, int
     buf[pos++] = options->keep_alive >> 8;
     buf[pos++] = options->keep_alive & 0xFF;
     
+    if (v5) {
+        pos += mqtt_properties_encode(&props, buf + pos, buf_len - pos);
+    }
+    
     // 载荷
     pos += encode_string(options->client_id, buf + pos);
     
     if (options->will.topic && options->will.message) {
+        if (v5) {
+            buf[pos++] = 0;
+        }
         pos += encode_string(options->will.topic, buf + pos);
         pos += encode_string(options->will.message, buf + pos);
     }
@@ -109,10 +162,10 @@ int mqtt_encode_connect(const mqtt_connect_options_t *options, uint8_t *buf, int
     return pos;
 }
 
-// 编码 PUBLISH 包
-int mqtt_encode_publish(const mqtt_message_t *message, uint16_t packet_id, 
-                       uint8_t *buf, int buf_len) {
-    if (!message || !buf || buf_len < 2) {
+// 编码 PUBLISH 包头部, props 非 NULL 时按 MQTT 5.0 编码属性
+static int encode_publish_header(const mqtt_message_t *message, uint16_t packet_id,
+                                 const mqtt_properties_t *props, uint8_t *buf, int buf_len) {
+    if (!message || !message->topic || !buf || buf_len < 2) {
         return -1;
     }
 
@@ -129,34 +182,128 @@ int mqtt_encode_publish(const mqtt_message_t *message, uint16_t packet_id,
     }
     buf[pos++] = header;
     
-    // 计算剩余长度
-    int remaining_length = 2 + strlen(message->topic); // 主题长度
+    // 计算剩余长度, topic_len 为 0 时主题是以 '\0' 结尾的字符串
+    uint16_t topic_len = message->topic_len ? message->topic_len : strlen(message->topic);
+    uint32_t header_length = 2 + topic_len; // 主题长度
     if (message->qos > 0) {
-        remaining_length += 2; // 报文标识符
+        header_length += 2; // 报文标识符
+    }
+    if (props) {
+        header_length += mqtt_properties_size(props);
+    }
+    uint32_t remaining_length = header_length + message->payload_len;
+    if (remaining_length > MQTT_MAX_REMAINING_LENGTH ||
+        (uint32_t)buf_len < 1 + 4 + header_length) {
+        return -1;
     }
-    remaining_length += message->payload_len;
     
     // 编码剩余长度
     pos += encode_remaining_length(remaining_length, buf + pos);
     
     // 可变头部
-    pos += encode_string(message->topic, buf + pos);
+    pos += encode_string_n(message->topic, topic_len, buf + pos);
     
     if (message->qos > 0) {
         buf[pos++] = packet_id >> 8;
         buf[pos++] = packet_id & 0xFF;
     }
     
+    if (props) {
+        pos += mqtt_properties_encode(props, buf + pos, buf_len - pos);
+    }
+    
+    return pos;
+}
+
+// 编码 PUBLISH 包头部 (固定头部和可变头部), 剩余长度包含 payload_len
+// 载荷由调用者紧接着发送, 不经过 buf
+int mqtt_encode_publish_header(const mqtt_message_t *message, uint16_t packet_id,
+                              uint8_t *buf, int buf_len) {
+    return encode_publish_header(message, packet_id, NULL, buf, buf_len);
+}
+
+// 编码 MQTT 5.0 PUBLISH 包头部, props 为 NULL 时属性长度为 0
+// 使用已建立的主题别名时 topic 为空字符串
+int mqtt_encode_publish_header_v5(const mqtt_message_t *message, uint16_t packet_id,
+                                 const mqtt_properties_t *props, uint8_t *buf, int buf_len) {
+    static const mqtt_properties_t no_props;
+    return encode_publish_header(message, packet_id, props ? props : &no_props, buf, buf_len);
+}
+
+// 预编码主题和固定头部标志, 一次分配
+mqtt_publish_template_t *mqtt_prepare_publish(const char *topic, mqtt_qos_t qos, bool retain) {
+    if (!topic || qos > MQTT_QOS_2) {
+        return NULL;
+    }
+    size_t topic_len = strlen(topic);
+    if (topic_len == 0 || topic_len > UINT16_MAX) {
+        return NULL;
+    }
+
+    // 编码后的主题之后再放一个 '\0', 使 topic 可以作为普通字符串使用
+    mqtt_publish_template_t *tpl = malloc(sizeof(mqtt_publish_template_t) + 2 + topic_len + 1);
+    if (tpl == NULL) {
+        return NULL;
+    }
+    tpl->header = MQTT_PUBLISH << 4 | qos << 1 | (retain ? 0x01 : 0);
+    tpl->qos = qos;
+    tpl->retain = retain;
+    tpl->topic_len = topic_len;
+    tpl->header_length = 2 + topic_len + (qos > 0 ? 2 : 0);
+    encode_string_n(topic, topic_len, tpl->encoded_topic);
+    tpl->encoded_topic[2 + topic_len] = '\0';
+    tpl->topic = (const char *)tpl->encoded_topic + 2;
+    return tpl;
+}
+
+void mqtt_publish_template_free(mqtt_publish_template_t *tpl) {
+    free(tpl);
+}
+
+// 按模板编码 PUBLISH 头部: 只写入 DUP 标志、剩余长度和报文标识符, 主题整段复制
+int mqtt_encode_publish_prepared(const mqtt_publish_template_t *tpl, uint16_t packet_id, bool dup,
+                                uint32_t payload_len, uint8_t *buf, int buf_len) {
+    if (!tpl || !buf) {
+        return -1;
+    }
+    uint32_t remaining_length = tpl->header_length + payload_len;
+    if (remaining_length > MQTT_MAX_REMAINING_LENGTH ||
+        buf_len < 1 + 4 + tpl->header_length) {
+        return -1;
+    }
+
+    int pos = 0;
+    buf[pos++] = tpl->header | (dup ? 0x08 : 0);
+    pos += encode_remaining_length(remaining_length, buf + pos);
+    memcpy(buf + pos, tpl->encoded_topic, 2 + tpl->topic_len);
+    pos += 2 + tpl->topic_len;
+    if (tpl->qos > 0) {
+        buf[pos++] = packet_id >> 8;
+        buf[pos++] = packet_id & 0xFF;
+    }
+    return pos;
+}
+
+// 编码 PUBLISH 包
+int mqtt_encode_publish(const mqtt_message_t *message, uint16_t packet_id, 
+                       uint8_t *buf, int buf_len) {
+    int pos = mqtt_encode_publish_header(message, packet_id, buf, buf_len);
+    if (pos < 0 || (uint32_t)(buf_len - pos) < message->payload_len) {
+        return -1;
+    }
+    
     // 载荷
-    memcpy(buf + pos, message->payload, message->payload_len);
+    if (message->payload_len > 0) {
+        memcpy(buf + pos, message->payload, message->payload_len);
+    }
     pos += message->payload_len;
     
     return pos;
 }
 
-// 编码 SUBSCRIBE 包
-int mqtt_encode_subscribe(uint16_t packet_id, const mqtt_topic_filter_t *topics,
-                         int topic_count, uint8_t *buf, int buf_len) {
+// 编码 SUBSCRIBE 包, v5 时在报文标识符后加入空属性
+static int encode_subscribe(uint16_t packet_id, const mqtt_topic_filter_t *topics,
+                            int topic_count, bool v5, uint8_t *buf, int buf_len) {
     if (!topics || !buf || buf_len < 2 || topic_count <= 0) {
         return -1;
     }
@@ -168,9 +315,15 @@ int mqtt_encode_subscribe(uint16_t packet_id, const mqtt_topic_filter_t *topics,
     
     // 计算剩余长度
     int remaining_length = 2; // 报文标识符
+    if (v5) {
+        remaining_length += 1; // 属性长度 0
+    }
     for (int i = 0; i < topic_count; i++) {
         remaining_length += 2 + strlen(topics[i].topic) + 1;
     }
+    if (buf_len < 1 + 4 + remaining_length) {
+        return -1;
+    }
     
     // 编码剩余长度
     pos += encode_remaining_length(remaining_length, buf + pos);
@@ -178,6 +331,9 @@ int mqtt_encode_subscribe(uint16_t packet_id, const mqtt_topic_filter_t *topics,
     // 可变头部
     buf[pos++] = packet_id >> 8;
     buf[pos++] = packet_id & 0xFF;
+    if (v5) {
+        buf[pos++] = 0;
+    }
     
     // 载荷
     for (int i = 0; i < topic_count; i++) {
@@ -188,9 +344,19 @@ int mqtt_encode_subscribe(uint16_t packet_id, const mqtt_topic_filter_t *topics,
     return pos;
 }
 
-// 编码 UNSUBSCRIBE 包
-int mqtt_encode_unsubscribe(uint16_t packet_id, const char **topics,
-                           int topic_count, uint8_t *buf, int buf_len) {
+int mqtt_encode_subscribe(uint16_t packet_id, const mqtt_topic_filter_t *topics,
+                         int topic_count, uint8_t *buf, int buf_len) {
+    return encode_subscribe(packet_id, topics, topic_count, false, buf, buf_len);
+}
+
+int mqtt_encode_subscribe_v5(uint16_t packet_id, const mqtt_topic_filter_t *topics,
+                            int topic_count, uint8_t *buf, int buf_len) {
+    return encode_subscribe(packet_id, topics, topic_count, true, buf, buf_len);
+}
+
+// 编码 UNSUBSCRIBE 包, v5 时在报文标识符后加入空属性
+static int encode_unsubscribe(uint16_t packet_id, const char **topics,
+                              int topic_count, bool v5, uint8_t *buf, int buf_len) {
     if (!topics || !buf || buf_len < 2 || topic_count <= 0) {
         return -1;
     }
@@ -202,9 +368,15 @@ int mqtt_encode_unsubscribe(uint16_t packet_id, const char **topics,
     
     // 计算剩余长度
     int remaining_length = 2; // 报文标识符
+    if (v5) {
+        remaining_length += 1; // 属性长度 0
+    }
     for (int i = 0; i < topic_count; i++) {
         remaining_length += 2 + strlen(topics[i]);
     }
+    if (buf_len < 1 + 4 + remaining_length) {
+        return -1;
+    }
     
     // 编码剩余长度
     pos += encode_remaining_length(remaining_length, buf + pos);
@@ -212,6 +384,9 @@ int mqtt_encode_unsubscribe(uint16_t packet_id, const char **topics,
     // 可变头部
     buf[pos++] = packet_id >> 8;
     buf[pos++] = packet_id & 0xFF;
+    if (v5) {
+        buf[pos++] = 0;
+    }
     
     // 载荷
     for (int i = 0; i < topic_count; i++) {
@@ -221,6 +396,16 @@ int mqtt_encode_unsubscribe(uint16_t packet_id, const char **topics,
     return pos;
 }
 
+int mqtt_encode_unsubscribe(uint16_t packet_id, const char **topics,
+                           int topic_count, uint8_t *buf, int buf_len) {
+    return encode_unsubscribe(packet_id, topics, topic_count, false, buf, buf_len);
+}
+
+int mqtt_encode_unsubscribe_v5(uint16_t packet_id, const char **topics,
+                              int topic_count, uint8_t *buf, int buf_len) {
+    return encode_unsubscribe(packet_id, topics, topic_count, true, buf, buf_len);
+}
+
 // 编码简单的控制包 (PINGREQ, PINGRESP, DISCONNECT)
 int mqtt_encode_simple_packet(mqtt_packet_type_t type, uint8_t *buf, int buf_len) {
     if (!buf || buf_len < 2) {
@@ -230,4 +415,21 @@ int mqtt_encode_simple_packet(mqtt_packet_type_t type, uint8_t *buf, int buf_len
     buf[0] = type << 4;
     buf[1] = 0;
     return 2;
-} 
\ No newline at end of file
+}
+
+// 编码确认包 (PUBACK, PUBREC, PUBREL, PUBCOMP, UNSUBACK)
+int mqtt_encode_ack(mqtt_packet_type_t type, uint16_t packet_id, uint8_t *buf, int buf_len) {
+    if (!buf || buf_len < 4) {
+        return -1;
+    }
+    
+    // PUBREL 固定头部保留位必须为 0010
+    buf[0] = type << 4;
+    if (type == MQTT_PUBREL) {
+        buf[0] |= 0x02;
+    }
+    buf[1] = 2;
+    buf[2] = packet_id >> 8;
+    buf[3] = packet_id & 0xFF;
+    return 4;
+}
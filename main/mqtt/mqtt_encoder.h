@@ -0,0 +1,50 @@
+#ifndef MQTT_ENCODER_H
+#define MQTT_ENCODER_H
+
+#include "mqtt_types.h"
+#include "mqtt_properties.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 预编码的 PUBLISH 模板, 用于反复发布到同一主题
+// 固定头部标志和带长度前缀的主题在准备时编码一次, 之后每条消息只需写入剩余长度和报文标识符
+typedef struct {
+    const char *topic;             // 以 '\0' 结尾, 指向模板内部
+    uint16_t topic_len;
+    uint16_t header_length;        // 可变头部长度: 主题 + 报文标识符
+    uint8_t header;                // 固定头部第一个字节, 不含 DUP
+    mqtt_qos_t qos;
+    bool retain;
+    uint8_t encoded_topic[];       // 2 字节长度 + 主题 + '\0'
+} mqtt_publish_template_t;
+
+// 失败返回 NULL, 用 mqtt_publish_template_free 释放
+mqtt_publish_template_t *mqtt_prepare_publish(const char *topic, mqtt_qos_t qos, bool retain);
+void mqtt_publish_template_free(mqtt_publish_template_t *tpl);
+
+// MQTT 编码API, 成功返回写入的字节数, 失败返回 -1
+int mqtt_encode_connect(const mqtt_connect_options_t *options, uint8_t *buf, int buf_len);
+int mqtt_encode_publish(const mqtt_message_t *message, uint16_t packet_id,
+                       uint8_t *buf, int buf_len);
+// 只编码头部, 载荷由调用者直接从自己的缓冲区发送
+int mqtt_encode_publish_header(const mqtt_message_t *message, uint16_t packet_id,
+                              uint8_t *buf, int buf_len);
+// 按模板编码头部, 剩余长度包含 payload_len, 载荷由调用者紧接着发送
+int mqtt_encode_publish_prepared(const mqtt_publish_template_t *tpl, uint16_t packet_id, bool dup,
+                                uint32_t payload_len, uint8_t *buf, int buf_len);
+int mqtt_encode_subscribe(uint16_t packet_id, const mqtt_topic_filter_t *topics,
+                         int topic_count, uint8_t *buf, int buf_len);
+int mqtt_encode_unsubscribe(uint16_t packet_id, const char **topics,
+                           int topic_count, uint8_t *buf, int buf_len);
+// MQTT 5.0 编码, CONNECT 按 options->protocol_version 选择版本
+int mqtt_encode_publish_header_v5(const mqtt_message_t *message, uint16_t packet_id,
+                                 const mqtt_properties_t *props, uint8_t *buf, int buf_len);
+int mqtt_encode_subscribe_v5(uint16_t packet_id, const mqtt_topic_filter_t *topics,
+                            int topic_count, uint8_t *buf, int buf_len);
+int mqtt_encode_unsubscribe_v5(uint16_t packet_id, const char **topics,
+                              int topic_count, uint8_t *buf, int buf_len);
+
+int mqtt_encode_simple_packet(mqtt_packet_type_t type, uint8_t *buf, int buf_len);
+int mqtt_encode_ack(mqtt_packet_type_t type, uint16_t packet_id, uint8_t *buf, int buf_len);
+
+#endif /* MQTT_ENCODER_H */
@@ -0,0 +1,141 @@
+#include "mqtt_framer.h"
+#include <stdbool.h>
+#include <string.h>
+
+// 剩余长度最多 4 字节
+#define MQTT_MAX_LENGTH_MULTIPLIER (128 * 128 * 128)
+
+void mqtt_framer_init(mqtt_framer_t *framer, uint8_t *buf, uint32_t capacity) {
+    framer->buf = buf;
+    framer->capacity = capacity;
+    mqtt_framer_reset(framer);
+}
+
+void mqtt_framer_reset(mqtt_framer_t *framer) {
+    framer->start = 0;
+    framer->scan = 0;
+    framer->end = 0;
+    framer->state = MQTT_FRAMER_STATE_HEADER;
+    framer->remaining_length = 0;
+    framer->multiplier = 1;
+    framer->packet_len = 0;
+    framer->stream_remaining = 0;
+}
+
+// 把未处理的数据移动到缓冲区头部
+static void framer_compact(mqtt_framer_t *framer) {
+    uint32_t pending = framer->end - framer->start;
+    if (pending > 0) {
+        memmove(framer->buf, framer->buf + framer->start, pending);
+    }
+    framer->scan -= framer->start;
+    framer->end = pending;
+    framer->start = 0;
+}
+
+uint8_t *mqtt_framer_write_ptr(mqtt_framer_t *framer, uint32_t *space) {
+    if (framer->start == framer->end) {
+        // 没有未处理的数据, 直接回到头部
+        framer->start = 0;
+        framer->scan = 0;
+        framer->end = 0;
+    } else if (framer->start > 0) {
+        // 尾部空间不足以容纳当前包, 或剩余空间少于四分之一时整理
+        uint32_t tail = framer->capacity - framer->end;
+        bool packet_overflows = framer->state == MQTT_FRAMER_STATE_STREAM_FILL ||
+                                (framer->state == MQTT_FRAMER_STATE_BODY &&
+                                 framer->start + framer->packet_len > framer->capacity);
+        if (packet_overflows || tail < framer->capacity / 4) {
+            framer_compact(framer);
+        }
+    }
+
+    *space = framer->capacity - framer->end;
+    return framer->buf + framer->end;
+}
+
+void mqtt_framer_commit(mqtt_framer_t *framer, uint32_t len) {
+    if (len > framer->capacity - framer->end) {
+        len = framer->capacity - framer->end;
+    }
+    framer->end += len;
+}
+
+int mqtt_framer_next(mqtt_framer_t *framer, const uint8_t **packet, uint32_t *packet_len) {
+    while (1) {
+        switch (framer->state) {
+            case MQTT_FRAMER_STATE_HEADER:
+                if (framer->scan >= framer->end) {
+                    return MQTT_FRAMER_NEED_MORE;
+                }
+                framer->scan++;
+                framer->remaining_length = 0;
+                framer->multiplier = 1;
+                framer->state = MQTT_FRAMER_STATE_LENGTH;
+                break;
+
+            case MQTT_FRAMER_STATE_LENGTH: {
+                if (framer->scan >= framer->end) {
+                    return MQTT_FRAMER_NEED_MORE;
+                }
+                uint8_t byte = framer->buf[framer->scan++];
+                framer->remaining_length += (byte & 127) * framer->multiplier;
+                if (byte & 128) {
+                    if (framer->multiplier == MQTT_MAX_LENGTH_MULTIPLIER) {
+                        return MQTT_FRAMER_ERR_MALFORMED;
+                    }
+                    framer->multiplier *= 128;
+                    break;
+                }
+                framer->packet_len = (framer->scan - framer->start) + framer->remaining_length;
+                framer->state = framer->packet_len > framer->capacity ?
+                                MQTT_FRAMER_STATE_STREAM_FILL : MQTT_FRAMER_STATE_BODY;
+                break;
+            }
+
+            case MQTT_FRAMER_STATE_STREAM_FILL:
+                // 整理后缓冲区被当前包填满才开始交付, 保证可变头部完整
+                if (framer->start != 0 || framer->end < framer->capacity) {
+                    return MQTT_FRAMER_NEED_MORE;
+                }
+                *packet = framer->buf;
+                *packet_len = framer->capacity;
+                framer->stream_remaining = framer->packet_len - framer->capacity;
+                framer->start = framer->end;
+                framer->scan = framer->end;
+                framer->state = MQTT_FRAMER_STATE_STREAM_BODY;
+                return MQTT_FRAMER_STREAM_BEGIN;
+
+            case MQTT_FRAMER_STATE_STREAM_BODY: {
+                if (framer->start == framer->end) {
+                    return MQTT_FRAMER_NEED_MORE;
+                }
+                uint32_t len = framer->end - framer->start;
+                if (len > framer->stream_remaining) {
+                    len = framer->stream_remaining;
+                }
+                *packet = framer->buf + framer->start;
+                *packet_len = len;
+                framer->start += len;
+                framer->scan = framer->start;
+                framer->stream_remaining -= len;
+                if (framer->stream_remaining > 0) {
+                    return MQTT_FRAMER_STREAM_CHUNK;
+                }
+                framer->state = MQTT_FRAMER_STATE_HEADER;
+                return MQTT_FRAMER_STREAM_END;
+            }
+
+            case MQTT_FRAMER_STATE_BODY:
+                if (framer->end - framer->start < framer->packet_len) {
+                    return MQTT_FRAMER_NEED_MORE;
+                }
+                *packet = framer->buf + framer->start;
+                *packet_len = framer->packet_len;
+                framer->start += framer->packet_len;
+                framer->scan = framer->start;
+                framer->state = MQTT_FRAMER_STATE_HEADER;
+                return MQTT_FRAMER_PACKET;
+        }
+    }
+}
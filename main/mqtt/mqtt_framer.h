@@ -0,0 +1,53 @@
+#ifndef MQTT_FRAMER_H
+#define MQTT_FRAMER_H
+
+#include <stdint.h>
+
+// MQTT 流式分帧器
+// 接收数据直接写入分帧缓冲区, 每次 recv 之后循环调用 mqtt_framer_next() 取出所有完整的包
+// 固定头部和剩余长度按字节增量解析, 数据不完整时保留解析状态, 下次 recv 后继续
+// 返回的包是缓冲区内的连续视图, 在下一次 mqtt_framer_write_ptr() 之前有效
+//
+// 超过缓冲区容量的包以流的方式交付: 先等缓冲区填满, 以 MQTT_FRAMER_STREAM_BEGIN
+// 返回包的前 capacity 字节 (含固定头部和可变头部), 之后每次返回新到达的数据,
+// 中间片段为 MQTT_FRAMER_STREAM_CHUNK, 最后一片为 MQTT_FRAMER_STREAM_END
+
+#define MQTT_FRAMER_STREAM_END     4   // 大包的最后一个片段
+#define MQTT_FRAMER_STREAM_CHUNK   3   // 大包的中间片段
+#define MQTT_FRAMER_STREAM_BEGIN   2   // 大包的第一个片段
+#define MQTT_FRAMER_PACKET         1   // 取出一个完整的包
+#define MQTT_FRAMER_NEED_MORE      0   // 需要更多数据
+#define MQTT_FRAMER_ERR_MALFORMED  -1  // 剩余长度编码非法
+
+typedef enum {
+    MQTT_FRAMER_STATE_HEADER,      // 等待固定头部首字节
+    MQTT_FRAMER_STATE_LENGTH,      // 解析剩余长度
+    MQTT_FRAMER_STATE_BODY,        // 等待可变头部和载荷
+    MQTT_FRAMER_STATE_STREAM_FILL, // 大包: 等待缓冲区填满
+    MQTT_FRAMER_STATE_STREAM_BODY  // 大包: 逐片交付剩余数据
+} mqtt_framer_state_t;
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t capacity;
+    uint32_t start;                // 当前包起始位置
+    uint32_t scan;                 // 已解析到的位置
+    uint32_t end;                  // 有效数据末尾
+    mqtt_framer_state_t state;
+    uint32_t remaining_length;
+    uint32_t multiplier;
+    uint32_t packet_len;           // 当前包总长度, BODY 及 STREAM 状态有效
+    uint32_t stream_remaining;     // 大包尚未交付的字节数
+} mqtt_framer_t;
+
+void mqtt_framer_init(mqtt_framer_t *framer, uint8_t *buf, uint32_t capacity);
+void mqtt_framer_reset(mqtt_framer_t *framer);
+
+// 返回可写入位置及可写字节数, 必要时把未处理的数据移动到缓冲区头部
+uint8_t *mqtt_framer_write_ptr(mqtt_framer_t *framer, uint32_t *space);
+// 提交写入的字节数
+void mqtt_framer_commit(mqtt_framer_t *framer, uint32_t len);
+// 取出下一个完整的包或大包片段, 大包总长度见 framer->packet_len
+int mqtt_framer_next(mqtt_framer_t *framer, const uint8_t **packet, uint32_t *packet_len);
+
+#endif /* MQTT_FRAMER_H */
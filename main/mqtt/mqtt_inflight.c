@@ -0,0 +1,117 @@
+#include "mqtt_inflight.h"
+#include <string.h>
+
+#define BUCKET(packet_id) ((packet_id) & (MQTT_INFLIGHT_HASH_SIZE - 1))
+
+void mqtt_inflight_init(mqtt_inflight_t *inflight) {
+    memset(inflight, 0, sizeof(mqtt_inflight_t));
+
+    for (uint16_t i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        inflight->entries[i].hash_next = i + 1 < MQTT_INFLIGHT_MAX ? i + 1 : MQTT_INFLIGHT_NONE;
+    }
+    for (uint16_t i = 0; i < MQTT_INFLIGHT_HASH_SIZE; i++) {
+        inflight->buckets[i] = MQTT_INFLIGHT_NONE;
+    }
+    inflight->free_head = 0;
+    inflight->fifo_head = MQTT_INFLIGHT_NONE;
+    inflight->fifo_tail = MQTT_INFLIGHT_NONE;
+}
+
+static uint16_t entry_index(const mqtt_inflight_t *inflight, const mqtt_inflight_entry_t *entry) {
+    return entry - inflight->entries;
+}
+
+static void fifo_unlink(mqtt_inflight_t *inflight, mqtt_inflight_entry_t *entry) {
+    if (entry->fifo_prev != MQTT_INFLIGHT_NONE) {
+        inflight->entries[entry->fifo_prev].fifo_next = entry->fifo_next;
+    } else {
+        inflight->fifo_head = entry->fifo_next;
+    }
+    if (entry->fifo_next != MQTT_INFLIGHT_NONE) {
+        inflight->entries[entry->fifo_next].fifo_prev = entry->fifo_prev;
+    } else {
+        inflight->fifo_tail = entry->fifo_prev;
+    }
+}
+
+static void fifo_append(mqtt_inflight_t *inflight, mqtt_inflight_entry_t *entry) {
+    uint16_t index = entry_index(inflight, entry);
+
+    entry->fifo_prev = inflight->fifo_tail;
+    entry->fifo_next = MQTT_INFLIGHT_NONE;
+    if (inflight->fifo_tail != MQTT_INFLIGHT_NONE) {
+        inflight->entries[inflight->fifo_tail].fifo_next = index;
+    } else {
+        inflight->fifo_head = index;
+    }
+    inflight->fifo_tail = index;
+}
+
+mqtt_inflight_entry_t *mqtt_inflight_find(mqtt_inflight_t *inflight, uint16_t packet_id) {
+    uint16_t index = inflight->buckets[BUCKET(packet_id)];
+    while (index != MQTT_INFLIGHT_NONE) {
+        mqtt_inflight_entry_t *entry = &inflight->entries[index];
+        if (entry->packet_id == packet_id) {
+            return entry;
+        }
+        index = entry->hash_next;
+    }
+    return NULL;
+}
+
+mqtt_inflight_entry_t *mqtt_inflight_add(mqtt_inflight_t *inflight, uint16_t packet_id,
+                                       mqtt_inflight_state_t state, int64_t now_us) {
+    if (inflight->free_head == MQTT_INFLIGHT_NONE ||
+        mqtt_inflight_find(inflight, packet_id) != NULL) {
+        return NULL;
+    }
+
+    uint16_t index = inflight->free_head;
+    mqtt_inflight_entry_t *entry = &inflight->entries[index];
+    inflight->free_head = entry->hash_next;
+
+    memset(entry, 0, sizeof(mqtt_inflight_entry_t));
+    entry->packet_id = packet_id;
+    entry->state = state;
+    entry->last_send_us = now_us;
+
+    entry->hash_next = inflight->buckets[BUCKET(packet_id)];
+    inflight->buckets[BUCKET(packet_id)] = index;
+    fifo_append(inflight, entry);
+    inflight->count++;
+
+    return entry;
+}
+
+void mqtt_inflight_touch(mqtt_inflight_t *inflight, mqtt_inflight_entry_t *entry, int64_t now_us) {
+    entry->last_send_us = now_us;
+    fifo_unlink(inflight, entry);
+    fifo_append(inflight, entry);
+}
+
+void mqtt_inflight_remove(mqtt_inflight_t *inflight, mqtt_inflight_entry_t *entry) {
+    uint16_t index = entry_index(inflight, entry);
+
+    // 从散列链中摘除
+    uint16_t *link = &inflight->buckets[BUCKET(entry->packet_id)];
+    while (*link != MQTT_INFLIGHT_NONE && *link != index) {
+        link = &inflight->entries[*link].hash_next;
+    }
+    if (*link == index) {
+        *link = entry->hash_next;
+    }
+
+    fifo_unlink(inflight, entry);
+
+    entry->state = MQTT_INFLIGHT_FREE;
+    entry->hash_next = inflight->free_head;
+    inflight->free_head = index;
+    inflight->count--;
+}
+
+mqtt_inflight_entry_t *mqtt_inflight_oldest(mqtt_inflight_t *inflight) {
+    if (inflight->fifo_head == MQTT_INFLIGHT_NONE) {
+        return NULL;
+    }
+    return &inflight->entries[inflight->fifo_head];
+}
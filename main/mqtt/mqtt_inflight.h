@@ -0,0 +1,63 @@
+#ifndef MQTT_INFLIGHT_H
+#define MQTT_INFLIGHT_H
+
+#include "mqtt_types.h"
+#include "mqtt_client.h"
+#include <stdint.h>
+
+// QoS 1/2 发送中消息存储
+// 预分配的定长数组, 按报文标识符散列查找, 同时按最后发送时间串成 FIFO:
+// 每次(重)发送把条目移到队尾, 队头就是最早需要重传的条目
+// 消息的 topic 和 payload 由调用者持有, 直到 done 被调用
+
+#define MQTT_INFLIGHT_MAX        32
+#define MQTT_INFLIGHT_HASH_SIZE  64    // 必须是 2 的幂
+#define MQTT_INFLIGHT_NONE       0xFFFF
+
+typedef enum {
+    MQTT_INFLIGHT_FREE,
+    MQTT_INFLIGHT_WAIT_PUBACK,     // QoS 1: 等待 PUBACK
+    MQTT_INFLIGHT_WAIT_PUBREC,     // QoS 2: 等待 PUBREC
+    MQTT_INFLIGHT_WAIT_PUBCOMP     // QoS 2: 已发送 PUBREL, 等待 PUBCOMP
+} mqtt_inflight_state_t;
+
+typedef struct {
+    mqtt_message_t message;
+    const char *content_type;      // MQTT 5.0 Content Type, 重传时一并发送, NULL 表示不带
+    mqtt_publish_done_t done;
+    void *done_arg;
+    int64_t last_send_us;
+    uint16_t packet_id;
+    uint8_t state;
+    uint8_t retries;
+    uint16_t hash_next;            // 散列链 / 空闲链
+    uint16_t fifo_prev;
+    uint16_t fifo_next;
+} mqtt_inflight_entry_t;
+
+typedef struct {
+    mqtt_inflight_entry_t entries[MQTT_INFLIGHT_MAX];
+    uint16_t buckets[MQTT_INFLIGHT_HASH_SIZE];
+    uint16_t free_head;
+    uint16_t fifo_head;
+    uint16_t fifo_tail;
+    uint16_t count;
+} mqtt_inflight_t;
+
+void mqtt_inflight_init(mqtt_inflight_t *inflight);
+
+// 存储已满或报文标识符已存在时返回 NULL
+mqtt_inflight_entry_t *mqtt_inflight_add(mqtt_inflight_t *inflight, uint16_t packet_id,
+                                       mqtt_inflight_state_t state, int64_t now_us);
+mqtt_inflight_entry_t *mqtt_inflight_find(mqtt_inflight_t *inflight, uint16_t packet_id);
+// 记录一次(重)发送, 条目移到 FIFO 队尾
+void mqtt_inflight_touch(mqtt_inflight_t *inflight, mqtt_inflight_entry_t *entry, int64_t now_us);
+void mqtt_inflight_remove(mqtt_inflight_t *inflight, mqtt_inflight_entry_t *entry);
+// 最后发送时间最早的条目, 为空时返回 NULL
+mqtt_inflight_entry_t *mqtt_inflight_oldest(mqtt_inflight_t *inflight);
+
+static inline uint16_t mqtt_inflight_count(const mqtt_inflight_t *inflight) {
+    return inflight->count;
+}
+
+#endif /* MQTT_INFLIGHT_H */
@@ -0,0 +1,70 @@
+#include "mqtt_packet_id.h"
+#include <string.h>
+
+static void mark_used(mqtt_packet_id_allocator_t *allocator, uint32_t id) {
+    uint32_t word = id >> 5;
+    allocator->used[word] |= 1u << (id & 31);
+    if (allocator->used[word] == UINT32_MAX) {
+        allocator->full[word >> 5] |= 1u << (word & 31);
+    }
+}
+
+void mqtt_packet_id_init(mqtt_packet_id_allocator_t *allocator) {
+    memset(allocator, 0, sizeof(mqtt_packet_id_allocator_t));
+    mark_used(allocator, 0);
+}
+
+// 从 word 开始 (含) 循环查找下一个未满的字, 全部已满返回 -1
+static int find_free_word(const mqtt_packet_id_allocator_t *allocator, uint32_t word) {
+    uint32_t index = word >> 5;
+    uint32_t mask = UINT32_MAX << (word & 31);
+
+    // 多查一轮以覆盖起始摘要字中低于起点的位
+    for (uint32_t i = 0; i <= MQTT_PACKET_ID_SUMMARY; i++) {
+        uint32_t free_words = ~allocator->full[index] & mask;
+        if (free_words) {
+            return (index << 5) + __builtin_ctz(free_words);
+        }
+        index = (index + 1) % MQTT_PACKET_ID_SUMMARY;
+        mask = UINT32_MAX;
+    }
+    return -1;
+}
+
+uint16_t mqtt_packet_id_alloc(mqtt_packet_id_allocator_t *allocator) {
+    uint32_t start = (allocator->cursor + 1) & 0xFFFF;
+    uint32_t word = start >> 5;
+    uint32_t id;
+
+    // 先在当前字中找起点之后的空位
+    uint32_t free_bits = ~allocator->used[word] & (UINT32_MAX << (start & 31));
+    if (free_bits) {
+        id = (word << 5) + __builtin_ctz(free_bits);
+    } else {
+        int next = find_free_word(allocator, (word + 1) % MQTT_PACKET_ID_WORDS);
+        if (next < 0) {
+            return 0;
+        }
+        id = ((uint32_t)next << 5) + __builtin_ctz(~allocator->used[next]);
+    }
+
+    mark_used(allocator, id);
+    allocator->cursor = id;
+    allocator->count++;
+    return id;
+}
+
+void mqtt_packet_id_release(mqtt_packet_id_allocator_t *allocator, uint16_t packet_id) {
+    if (packet_id == 0 || !mqtt_packet_id_in_use(allocator, packet_id)) {
+        return;
+    }
+
+    uint32_t word = packet_id >> 5;
+    allocator->used[word] &= ~(1u << (packet_id & 31));
+    allocator->full[word >> 5] &= ~(1u << (word & 31));
+    allocator->count--;
+}
+
+bool mqtt_packet_id_in_use(const mqtt_packet_id_allocator_t *allocator, uint16_t packet_id) {
+    return (allocator->used[packet_id >> 5] >> (packet_id & 31)) & 1;
+}
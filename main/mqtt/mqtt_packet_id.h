@@ -0,0 +1,28 @@
+#ifndef MQTT_PACKET_ID_H
+#define MQTT_PACKET_ID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// 报文标识符分配器
+// 每个标识符占一位, 另有一层摘要位图标记已满的字: 分配时先查当前字,
+// 再用 ctz 在摘要中找下一个未满的字, 释放只清两个位
+// 从上次分配的位置向后轮转分配, 刚释放的标识符不会立即被复用; 0 保留不分配
+
+#define MQTT_PACKET_ID_WORDS   (65536 / 32)
+#define MQTT_PACKET_ID_SUMMARY (MQTT_PACKET_ID_WORDS / 32)
+
+typedef struct {
+    uint32_t used[MQTT_PACKET_ID_WORDS];       // 标识符占用位
+    uint32_t full[MQTT_PACKET_ID_SUMMARY];     // 对应的字已全部占用
+    uint16_t cursor;                           // 上次分配的标识符
+    uint16_t count;                            // 已分配数量, 不含保留的 0
+} mqtt_packet_id_allocator_t;
+
+void mqtt_packet_id_init(mqtt_packet_id_allocator_t *allocator);
+// 分配一个空闲的标识符, 全部占用时返回 0
+uint16_t mqtt_packet_id_alloc(mqtt_packet_id_allocator_t *allocator);
+void mqtt_packet_id_release(mqtt_packet_id_allocator_t *allocator, uint16_t packet_id);
+bool mqtt_packet_id_in_use(const mqtt_packet_id_allocator_t *allocator, uint16_t packet_id);
+
+#endif /* MQTT_PACKET_ID_H */
@@ -0,0 +1,288 @@
+#include "mqtt_properties.h"
+#include <string.h>
+
+// 属性值类型
+typedef enum {
+    PROP_TYPE_INVALID,
+    PROP_TYPE_BYTE,
+    PROP_TYPE_TWO_BYTE,
+    PROP_TYPE_FOUR_BYTE,
+    PROP_TYPE_VARINT,
+    PROP_TYPE_STRING,
+    PROP_TYPE_BINARY,
+    PROP_TYPE_STRING_PAIR
+} prop_type_t;
+
+static prop_type_t property_type(uint8_t id) {
+    switch (id) {
+        case MQTT_PROP_PAYLOAD_FORMAT:
+        case MQTT_PROP_REQUEST_PROBLEM_INFO:
+        case MQTT_PROP_REQUEST_RESPONSE_INFO:
+        case MQTT_PROP_MAXIMUM_QOS:
+        case MQTT_PROP_RETAIN_AVAILABLE:
+        case MQTT_PROP_WILDCARD_SUB_AVAILABLE:
+        case MQTT_PROP_SUB_ID_AVAILABLE:
+        case MQTT_PROP_SHARED_SUB_AVAILABLE:
+            return PROP_TYPE_BYTE;
+        case MQTT_PROP_SERVER_KEEP_ALIVE:
+        case MQTT_PROP_RECEIVE_MAXIMUM:
+        case MQTT_PROP_TOPIC_ALIAS_MAXIMUM:
+        case MQTT_PROP_TOPIC_ALIAS:
+            return PROP_TYPE_TWO_BYTE;
+        case MQTT_PROP_MESSAGE_EXPIRY:
+        case MQTT_PROP_SESSION_EXPIRY:
+        case MQTT_PROP_WILL_DELAY:
+        case MQTT_PROP_MAXIMUM_PACKET_SIZE:
+            return PROP_TYPE_FOUR_BYTE;
+        case MQTT_PROP_SUBSCRIPTION_ID:
+            return PROP_TYPE_VARINT;
+        case MQTT_PROP_CONTENT_TYPE:
+        case MQTT_PROP_RESPONSE_TOPIC:
+        case MQTT_PROP_ASSIGNED_CLIENT_ID:
+        case MQTT_PROP_AUTH_METHOD:
+        case MQTT_PROP_RESPONSE_INFO:
+        case MQTT_PROP_SERVER_REFERENCE:
+        case MQTT_PROP_REASON_STRING:
+            return PROP_TYPE_STRING;
+        case MQTT_PROP_CORRELATION_DATA:
+        case MQTT_PROP_AUTH_DATA:
+            return PROP_TYPE_BINARY;
+        case MQTT_PROP_USER_PROPERTY:
+            return PROP_TYPE_STRING_PAIR;
+        default:
+            return PROP_TYPE_INVALID;
+    }
+}
+
+int mqtt_varint_size(uint32_t value) {
+    if (value < 128) return 1;
+    if (value < 16384) return 2;
+    if (value < 2097152) return 3;
+    return 4;
+}
+
+int mqtt_varint_encode(uint32_t value, uint8_t *buf) {
+    int encoded = 0;
+    do {
+        uint8_t byte = value % 128;
+        value /= 128;
+        if (value > 0) {
+            byte |= 0x80;
+        }
+        buf[encoded++] = byte;
+    } while (value > 0 && encoded < 4);
+    return encoded;
+}
+
+int mqtt_varint_decode(const uint8_t *buf, int buf_len, uint32_t *value) {
+    uint32_t result = 0;
+    uint32_t multiplier = 1;
+
+    for (int i = 0; i < 4; i++) {
+        if (i >= buf_len) return -1;
+        result += (buf[i] & 127) * multiplier;
+        if ((buf[i] & 128) == 0) {
+            *value = result;
+            return i + 1;
+        }
+        multiplier *= 128;
+    }
+    return -1;
+}
+
+// 客户端会发送的属性, 按标识符顺序编码
+static const uint8_t encodable_ids[] = {
+    MQTT_PROP_PAYLOAD_FORMAT,
+    MQTT_PROP_MESSAGE_EXPIRY,
+    MQTT_PROP_CONTENT_TYPE,
+    MQTT_PROP_SESSION_EXPIRY,
+    MQTT_PROP_RECEIVE_MAXIMUM,
+    MQTT_PROP_TOPIC_ALIAS_MAXIMUM,
+    MQTT_PROP_TOPIC_ALIAS,
+    MQTT_PROP_MAXIMUM_PACKET_SIZE
+};
+
+// 单个属性 (含标识符) 的长度
+static int property_size(const mqtt_properties_t *props, uint8_t id) {
+    switch (property_type(id)) {
+        case PROP_TYPE_BYTE:      return 2;
+        case PROP_TYPE_TWO_BYTE:  return 3;
+        case PROP_TYPE_FOUR_BYTE: return 5;
+        case PROP_TYPE_STRING:    return 3 + props->content_type_len;  // 只编码 content_type
+        default:                  return 0;
+    }
+}
+
+// 属性区长度, 不含长度前缀
+static uint32_t properties_length(const mqtt_properties_t *props) {
+    uint32_t length = 0;
+    if (props == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(encodable_ids); i++) {
+        if (props->present & MQTT_PROP_BIT(encodable_ids[i])) {
+            length += property_size(props, encodable_ids[i]);
+        }
+    }
+    return length;
+}
+
+int mqtt_properties_size(const mqtt_properties_t *props) {
+    uint32_t length = properties_length(props);
+    return mqtt_varint_size(length) + length;
+}
+
+static int put_u16(uint8_t *buf, uint16_t value) {
+    buf[0] = value >> 8;
+    buf[1] = value & 0xFF;
+    return 2;
+}
+
+static int put_u32(uint8_t *buf, uint32_t value) {
+    buf[0] = value >> 24;
+    buf[1] = (value >> 16) & 0xFF;
+    buf[2] = (value >> 8) & 0xFF;
+    buf[3] = value & 0xFF;
+    return 4;
+}
+
+int mqtt_properties_encode(const mqtt_properties_t *props, uint8_t *buf, int buf_len) {
+    uint32_t length = properties_length(props);
+    if (!buf || buf_len < mqtt_varint_size(length) + (int)length) {
+        return -1;
+    }
+
+    int pos = mqtt_varint_encode(length, buf);
+    if (length == 0) {
+        return pos;
+    }
+
+    for (size_t i = 0; i < sizeof(encodable_ids); i++) {
+        uint8_t id = encodable_ids[i];
+        if ((props->present & MQTT_PROP_BIT(id)) == 0) {
+            continue;
+        }
+        buf[pos++] = id;
+        switch (id) {
+            case MQTT_PROP_PAYLOAD_FORMAT:
+                buf[pos++] = props->payload_format;
+                break;
+            case MQTT_PROP_MESSAGE_EXPIRY:
+                pos += put_u32(buf + pos, props->message_expiry);
+                break;
+            case MQTT_PROP_CONTENT_TYPE:
+                pos += put_u16(buf + pos, props->content_type_len);
+                memcpy(buf + pos, props->content_type, props->content_type_len);
+                pos += props->content_type_len;
+                break;
+            case MQTT_PROP_SESSION_EXPIRY:
+                pos += put_u32(buf + pos, props->session_expiry);
+                break;
+            case MQTT_PROP_RECEIVE_MAXIMUM:
+                pos += put_u16(buf + pos, props->receive_maximum);
+                break;
+            case MQTT_PROP_TOPIC_ALIAS_MAXIMUM:
+                pos += put_u16(buf + pos, props->topic_alias_maximum);
+                break;
+            case MQTT_PROP_TOPIC_ALIAS:
+                pos += put_u16(buf + pos, props->topic_alias);
+                break;
+            case MQTT_PROP_MAXIMUM_PACKET_SIZE:
+                pos += put_u32(buf + pos, props->maximum_packet_size);
+                break;
+        }
+    }
+    return pos;
+}
+
+int mqtt_properties_decode(const uint8_t *buf, int buf_len, mqtt_properties_t *props) {
+    uint32_t length;
+    int pos = mqtt_varint_decode(buf, buf_len, &length);
+    if (pos < 0 || (uint32_t)(buf_len - pos) < length) return -1;
+
+    memset(props, 0, sizeof(mqtt_properties_t));
+    int end = pos + length;
+
+    while (pos < end) {
+        uint8_t id = buf[pos++];
+        const uint8_t *value = buf + pos;
+        int remaining = end - pos;
+        uint32_t number = 0;
+        const char *str = NULL;
+        uint16_t str_len = 0;
+
+        switch (property_type(id)) {
+            case PROP_TYPE_BYTE:
+                if (remaining < 1) return -1;
+                number = value[0];
+                pos += 1;
+                break;
+            case PROP_TYPE_TWO_BYTE:
+                if (remaining < 2) return -1;
+                number = (value[0] << 8) | value[1];
+                pos += 2;
+                break;
+            case PROP_TYPE_FOUR_BYTE:
+                if (remaining < 4) return -1;
+                number = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) |
+                         ((uint32_t)value[2] << 8) | value[3];
+                pos += 4;
+                break;
+            case PROP_TYPE_VARINT: {
+                int n = mqtt_varint_decode(value, remaining, &number);
+                if (n < 0) return -1;
+                pos += n;
+                break;
+            }
+            case PROP_TYPE_STRING:
+            case PROP_TYPE_BINARY:
+                if (remaining < 2) return -1;
+                str_len = (value[0] << 8) | value[1];
+                if (remaining < 2 + str_len) return -1;
+                str = (const char *)value + 2;
+                pos += 2 + str_len;
+                break;
+            case PROP_TYPE_STRING_PAIR: {
+                // 用户属性: 两个字符串, 直接跳过
+                for (int i = 0; i < 2; i++) {
+                    if (end - pos < 2) return -1;
+                    uint16_t len = (buf[pos] << 8) | buf[pos + 1];
+                    if (end - pos < 2 + len) return -1;
+                    pos += 2 + len;
+                }
+                continue;
+            }
+            default:
+                return -1;
+        }
+
+        props->present |= MQTT_PROP_BIT(id);
+        switch (id) {
+            case MQTT_PROP_PAYLOAD_FORMAT:      props->payload_format = number; break;
+            case MQTT_PROP_MESSAGE_EXPIRY:      props->message_expiry = number; break;
+            case MQTT_PROP_SESSION_EXPIRY:      props->session_expiry = number; break;
+            case MQTT_PROP_SERVER_KEEP_ALIVE:   props->server_keep_alive = number; break;
+            case MQTT_PROP_RECEIVE_MAXIMUM:     props->receive_maximum = number; break;
+            case MQTT_PROP_TOPIC_ALIAS_MAXIMUM: props->topic_alias_maximum = number; break;
+            case MQTT_PROP_TOPIC_ALIAS:         props->topic_alias = number; break;
+            case MQTT_PROP_MAXIMUM_QOS:         props->maximum_qos = number; break;
+            case MQTT_PROP_RETAIN_AVAILABLE:    props->retain_available = number; break;
+            case MQTT_PROP_MAXIMUM_PACKET_SIZE: props->maximum_packet_size = number; break;
+            case MQTT_PROP_CONTENT_TYPE:
+                props->content_type = str;
+                props->content_type_len = str_len;
+                break;
+            case MQTT_PROP_ASSIGNED_CLIENT_ID:
+                props->assigned_client_id = str;
+                props->assigned_client_id_len = str_len;
+                break;
+            case MQTT_PROP_REASON_STRING:
+                props->reason_string = str;
+                props->reason_string_len = str_len;
+                break;
+            default:
+                break;
+        }
+    }
+    return pos;
+}
@@ -0,0 +1,82 @@
+#ifndef MQTT_PROPERTIES_H
+#define MQTT_PROPERTIES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// MQTT 5.0 属性编解码
+// 只解析客户端需要的属性, 其他合法属性按类型跳过
+// 字符串属性解码后指向原缓冲区, 不以 '\0' 结尾
+
+// 属性标识符
+typedef enum {
+    MQTT_PROP_PAYLOAD_FORMAT         = 0x01,
+    MQTT_PROP_MESSAGE_EXPIRY         = 0x02,
+    MQTT_PROP_CONTENT_TYPE           = 0x03,
+    MQTT_PROP_RESPONSE_TOPIC         = 0x08,
+    MQTT_PROP_CORRELATION_DATA       = 0x09,
+    MQTT_PROP_SUBSCRIPTION_ID        = 0x0B,
+    MQTT_PROP_SESSION_EXPIRY         = 0x11,
+    MQTT_PROP_ASSIGNED_CLIENT_ID     = 0x12,
+    MQTT_PROP_SERVER_KEEP_ALIVE      = 0x13,
+    MQTT_PROP_AUTH_METHOD            = 0x15,
+    MQTT_PROP_AUTH_DATA              = 0x16,
+    MQTT_PROP_REQUEST_PROBLEM_INFO   = 0x17,
+    MQTT_PROP_WILL_DELAY             = 0x18,
+    MQTT_PROP_REQUEST_RESPONSE_INFO  = 0x19,
+    MQTT_PROP_RESPONSE_INFO          = 0x1A,
+    MQTT_PROP_SERVER_REFERENCE       = 0x1C,
+    MQTT_PROP_REASON_STRING          = 0x1F,
+    MQTT_PROP_RECEIVE_MAXIMUM        = 0x21,
+    MQTT_PROP_TOPIC_ALIAS_MAXIMUM    = 0x22,
+    MQTT_PROP_TOPIC_ALIAS            = 0x23,
+    MQTT_PROP_MAXIMUM_QOS            = 0x24,
+    MQTT_PROP_RETAIN_AVAILABLE       = 0x25,
+    MQTT_PROP_USER_PROPERTY          = 0x26,
+    MQTT_PROP_MAXIMUM_PACKET_SIZE    = 0x27,
+    MQTT_PROP_WILDCARD_SUB_AVAILABLE = 0x28,
+    MQTT_PROP_SUB_ID_AVAILABLE       = 0x29,
+    MQTT_PROP_SHARED_SUB_AVAILABLE   = 0x2A
+} mqtt_property_id_t;
+
+// present 位图中的位
+#define MQTT_PROP_BIT(id) (1ull << (id))
+
+// 客户端关心的属性
+typedef struct {
+    uint64_t present;              // MQTT_PROP_BIT(id) 置位表示对应字段有效
+    uint8_t payload_format;
+    uint32_t message_expiry;
+    const char *content_type;
+    uint16_t content_type_len;
+    uint32_t session_expiry;
+    const char *assigned_client_id;
+    uint16_t assigned_client_id_len;
+    uint16_t server_keep_alive;
+    const char *reason_string;
+    uint16_t reason_string_len;
+    uint16_t receive_maximum;
+    uint16_t topic_alias_maximum;
+    uint16_t topic_alias;
+    uint8_t maximum_qos;
+    uint8_t retain_available;
+    uint32_t maximum_packet_size;
+} mqtt_properties_t;
+
+static inline bool mqtt_properties_has(const mqtt_properties_t *props, mqtt_property_id_t id) {
+    return props && (props->present & MQTT_PROP_BIT(id)) != 0;
+}
+
+// 编码后的总长度 (含属性长度前缀), props 为 NULL 时为 1
+int mqtt_properties_size(const mqtt_properties_t *props);
+// 编码属性长度和属性, 返回写入的字节数, 失败返回 -1
+int mqtt_properties_encode(const mqtt_properties_t *props, uint8_t *buf, int buf_len);
+// 解码属性长度和属性, 返回消耗的字节数, 失败返回 -1
+int mqtt_properties_decode(const uint8_t *buf, int buf_len, mqtt_properties_t *props);
+
+// 变长整数编解码 (与剩余长度相同的编码)
+int mqtt_varint_size(uint32_t value);
+int mqtt_varint_encode(uint32_t value, uint8_t *buf);
+int mqtt_varint_decode(const uint8_t *buf, int buf_len, uint32_t *value);
+
+#endif /* MQTT_PROPERTIES_H */
@@ -0,0 +1,130 @@
+#include "mqtt_subscriptions.h"
+#include <stdlib.h>
+#include <string.h>
+
+static mqtt_subscription_t *find(mqtt_subscriptions_t *subs, const char *topic, uint16_t topic_len) {
+    for (uint16_t i = 0; i < subs->count; i++) {
+        mqtt_subscription_t *sub = &subs->entries[i];
+        if (sub->topic_len == topic_len && memcmp(sub->topic, topic, topic_len) == 0) {
+            return sub;
+        }
+    }
+    return NULL;
+}
+
+static void set_pending(mqtt_subscriptions_t *subs, mqtt_subscription_t *sub) {
+    if (sub->state != MQTT_SUBSCRIPTION_PENDING) {
+        sub->state = MQTT_SUBSCRIPTION_PENDING;
+        subs->pending++;
+    }
+    sub->packet_id = 0;
+}
+
+void mqtt_subscriptions_init(mqtt_subscriptions_t *subs) {
+    memset(subs, 0, sizeof(mqtt_subscriptions_t));
+}
+
+esp_err_t mqtt_subscriptions_add(mqtt_subscriptions_t *subs, char *topic, mqtt_qos_t qos) {
+    uint16_t topic_len = strlen(topic);
+    mqtt_subscription_t *sub = find(subs, topic, topic_len);
+
+    if (sub) {
+        free(topic);
+    } else {
+        if (subs->count == MQTT_SUBSCRIPTIONS_MAX) {
+            free(topic);
+            return ESP_ERR_NO_MEM;
+        }
+        sub = &subs->entries[subs->count++];
+        memset(sub, 0, sizeof(mqtt_subscription_t));
+        sub->topic = topic;
+        sub->topic_len = topic_len;
+        sub->state = MQTT_SUBSCRIPTION_FAILED;
+    }
+    sub->qos = qos;
+    set_pending(subs, sub);
+    return ESP_OK;
+}
+
+bool mqtt_subscriptions_remove(mqtt_subscriptions_t *subs, const char *topic) {
+    mqtt_subscription_t *sub = find(subs, topic, strlen(topic));
+    if (sub == NULL) {
+        return false;
+    }
+
+    if (sub->state == MQTT_SUBSCRIPTION_PENDING) {
+        subs->pending--;
+    }
+    free(sub->topic);
+    // 顺序无关, 用最后一项填补空位
+    *sub = subs->entries[--subs->count];
+    return true;
+}
+
+int mqtt_subscriptions_take_batch(mqtt_subscriptions_t *subs, uint16_t packet_id, uint32_t max_bytes,
+                                 mqtt_topic_filter_t *filters, int max_filters) {
+    uint32_t used = 0;
+    int count = 0;
+
+    for (uint16_t i = 0; i < subs->count && count < max_filters; i++) {
+        mqtt_subscription_t *sub = &subs->entries[i];
+        if (sub->state != MQTT_SUBSCRIPTION_PENDING) {
+            continue;
+        }
+        // 长度前缀 + 主题 + 订阅选项
+        uint32_t size = 2 + sub->topic_len + 1;
+        if (used + size > max_bytes) {
+            continue;
+        }
+
+        filters[count].topic = sub->topic;
+        filters[count].qos = sub->qos;
+        sub->state = MQTT_SUBSCRIPTION_SENT;
+        sub->packet_id = packet_id;
+        sub->suback_index = count;
+        subs->pending--;
+        used += size;
+        count++;
+    }
+    return count;
+}
+
+void mqtt_subscriptions_requeue(mqtt_subscriptions_t *subs, uint16_t packet_id) {
+    for (uint16_t i = 0; i < subs->count; i++) {
+        mqtt_subscription_t *sub = &subs->entries[i];
+        if (sub->state == MQTT_SUBSCRIPTION_SENT &&
+            (packet_id == 0 || sub->packet_id == packet_id)) {
+            set_pending(subs, sub);
+        }
+    }
+}
+
+int mqtt_subscriptions_ack(mqtt_subscriptions_t *subs, uint16_t packet_id,
+                          const uint8_t *codes, int count,
+                          mqtt_subscription_fn_t fn, void *arg) {
+    int matched = 0;
+
+    for (uint16_t i = 0; i < subs->count; i++) {
+        mqtt_subscription_t *sub = &subs->entries[i];
+        if (sub->state != MQTT_SUBSCRIPTION_SENT || sub->packet_id != packet_id ||
+            sub->suback_index >= count) {
+            continue;
+        }
+
+        uint8_t code = codes[sub->suback_index];
+        sub->granted_qos = code;
+        sub->state = code < MQTT_SUBACK_FAILURE ? MQTT_SUBSCRIPTION_ACTIVE : MQTT_SUBSCRIPTION_FAILED;
+        sub->packet_id = 0;
+        matched++;
+        if (fn) {
+            fn(sub, arg);
+        }
+    }
+    return matched;
+}
+
+void mqtt_subscriptions_resubscribe_all(mqtt_subscriptions_t *subs) {
+    for (uint16_t i = 0; i < subs->count; i++) {
+        set_pending(subs, &subs->entries[i]);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef MQTT_SUBSCRIPTIONS_H
+#define MQTT_SUBSCRIPTIONS_H
+
+#include "mqtt_types.h"
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 订阅登记表
+// 所有订阅都登记在表中, 待发送的过滤器尽量多地合并进同一个 SUBSCRIBE,
+// 多个 SUBSCRIBE 连续发出而不等待各自的 SUBACK.
+// 每个过滤器记录所在 SUBSCRIBE 的报文标识符和位置, SUBACK 的返回码按位置对应回过滤器
+// 重连后全部条目重新置为待发送
+
+#define MQTT_SUBSCRIPTIONS_MAX        64
+#define MQTT_SUBSCRIBE_MAX_FILTERS    16    // 每个 SUBSCRIBE 最多合并的过滤器数
+#define MQTT_SUBACK_FAILURE           0x80  // 3.1.1 失败返回码, 5.0 中 >= 0x80 均为失败
+
+typedef enum {
+    MQTT_SUBSCRIPTION_PENDING,     // 等待发送
+    MQTT_SUBSCRIPTION_SENT,        // 已发送, 等待 SUBACK
+    MQTT_SUBSCRIPTION_ACTIVE,      // 服务端已接受
+    MQTT_SUBSCRIPTION_FAILED       // 服务端拒绝
+} mqtt_subscription_state_t;
+
+typedef struct {
+    char *topic;                   // 由登记表持有
+    uint16_t topic_len;
+    uint16_t packet_id;            // SENT 时所在 SUBSCRIBE 的报文标识符
+    uint8_t qos;                   // 请求的 QoS
+    uint8_t granted_qos;           // SUBACK 返回码
+    uint8_t state;
+    uint8_t suback_index;          // 在 SUBSCRIBE 中的位置
+} mqtt_subscription_t;
+
+typedef struct {
+    mqtt_subscription_t entries[MQTT_SUBSCRIPTIONS_MAX];
+    uint16_t count;
+    uint16_t pending;              // PENDING 状态的条目数
+} mqtt_subscriptions_t;
+
+// SUBACK 对应到过滤器后调用
+typedef void (*mqtt_subscription_fn_t)(const mqtt_subscription_t *sub, void *arg);
+
+void mqtt_subscriptions_init(mqtt_subscriptions_t *subs);
+// 接管 malloc 分配的 topic. 已登记的过滤器更新 QoS 并重新订阅
+esp_err_t mqtt_subscriptions_add(mqtt_subscriptions_t *subs, char *topic, mqtt_qos_t qos);
+// 未登记返回 false
+bool mqtt_subscriptions_remove(mqtt_subscriptions_t *subs, const char *topic);
+// 取出编码后总长不超过 max_bytes 的待发送过滤器 (最多 max_filters 个),
+// 标记为已发送并记录 packet_id, 返回取出的个数. filters 中的 topic 指向登记表
+int mqtt_subscriptions_take_batch(mqtt_subscriptions_t *subs, uint16_t packet_id, uint32_t max_bytes,
+                                 mqtt_topic_filter_t *filters, int max_filters);
+// 把 packet_id 对应的已发送过滤器放回待发送, packet_id 为 0 时放回全部已发送的过滤器
+void mqtt_subscriptions_requeue(mqtt_subscriptions_t *subs, uint16_t packet_id);
+// 按位置应用 SUBACK 返回码, 对每个对应上的过滤器调用 fn (可为 NULL), 返回对应上的个数
+int mqtt_subscriptions_ack(mqtt_subscriptions_t *subs, uint16_t packet_id,
+                          const uint8_t *codes, int count,
+                          mqtt_subscription_fn_t fn, void *arg);
+// 全部条目置为待发送, 新会话建立后调用
+void mqtt_subscriptions_resubscribe_all(mqtt_subscriptions_t *subs);
+
+#endif /* MQTT_SUBSCRIPTIONS_H */
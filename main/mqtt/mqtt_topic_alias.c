@@ -0,0 +1,91 @@
+#include "mqtt_topic_alias.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *entry_topic(const mqtt_topic_alias_entry_t *entry) {
+    return entry->long_topic ? entry->long_topic : entry->topic;
+}
+
+void mqtt_topic_alias_reset(mqtt_topic_alias_table_t *table, uint16_t maximum) {
+    for (uint16_t i = 0; i < MQTT_TOPIC_ALIAS_MAX; i++) {
+        free(table->entries[i].long_topic);
+    }
+    memset(table, 0, sizeof(mqtt_topic_alias_table_t));
+    table->capacity = maximum < MQTT_TOPIC_ALIAS_MAX ? maximum : MQTT_TOPIC_ALIAS_MAX;
+}
+
+uint16_t mqtt_topic_alias_find(mqtt_topic_alias_table_t *table, const char *topic, uint16_t topic_len) {
+    for (uint16_t i = 0; i < table->capacity; i++) {
+        mqtt_topic_alias_entry_t *entry = &table->entries[i];
+        if (entry->topic_len == topic_len && memcmp(entry_topic(entry), topic, topic_len) == 0) {
+            entry->last_used = ++table->clock;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+uint16_t mqtt_topic_alias_victim(mqtt_topic_alias_table_t *table, uint16_t topic_len) {
+    if (table->capacity == 0 || topic_len == 0 || topic_len > MQTT_TOPIC_ALIAS_TOPIC_LEN) {
+        return 0;
+    }
+
+    uint16_t victim = 0;
+    for (uint16_t i = 0; i < table->capacity; i++) {
+        const mqtt_topic_alias_entry_t *entry = &table->entries[i];
+        if (entry->topic_len == 0) {
+            return i + 1;
+        }
+        if (entry->last_used < table->entries[victim].last_used) {
+            victim = i;
+        }
+    }
+    return victim + 1;
+}
+
+bool mqtt_topic_alias_set(mqtt_topic_alias_table_t *table, uint16_t alias,
+                         const char *topic, uint16_t topic_len) {
+    if (alias == 0 || alias > table->capacity) {
+        return false;
+    }
+
+    mqtt_topic_alias_entry_t *entry = &table->entries[alias - 1];
+    if (topic_len > MQTT_TOPIC_ALIAS_TOPIC_LEN) {
+        char *copy = topic_len <= MQTT_TOPIC_ALIAS_LONG_TOPIC_MAX ?
+                     realloc(entry->long_topic, topic_len) : NULL;
+        if (copy == NULL) {
+            free(entry->long_topic);
+            entry->long_topic = NULL;
+            entry->topic_len = 0;
+            return false;
+        }
+        entry->long_topic = copy;
+    } else {
+        free(entry->long_topic);
+        entry->long_topic = NULL;
+    }
+
+    if (topic_len == 0) {
+        entry->topic_len = 0;
+        return false;
+    }
+    memcpy((char *)entry_topic(entry), topic, topic_len);
+    entry->topic_len = topic_len;
+    entry->last_used = ++table->clock;
+    return true;
+}
+
+const char *mqtt_topic_alias_resolve(mqtt_topic_alias_table_t *table, uint16_t alias,
+                                    uint16_t *topic_len) {
+    if (alias == 0 || alias > table->capacity) {
+        return NULL;
+    }
+
+    mqtt_topic_alias_entry_t *entry = &table->entries[alias - 1];
+    if (entry->topic_len == 0) {
+        return NULL;
+    }
+    entry->last_used = ++table->clock;
+    *topic_len = entry->topic_len;
+    return entry_topic(entry);
+}
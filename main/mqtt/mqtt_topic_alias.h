@@ -0,0 +1,41 @@
+#ifndef MQTT_TOPIC_ALIAS_H
+#define MQTT_TOPIC_ALIAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// MQTT 5.0 主题别名表, 每个连接一张发送表和一张接收表
+// 发送时先查已建立的别名, 未建立时取空闲或最久未用的别名, 包编码成功后再登记,
+// 之后同一主题只发送 2 字节别名. 别名只在本次连接内有效, CONNACK 后重置
+
+#define MQTT_TOPIC_ALIAS_MAX        16
+#define MQTT_TOPIC_ALIAS_TOPIC_LEN  64     // 发送时更长的主题不使用别名
+#define MQTT_TOPIC_ALIAS_LONG_TOPIC_MAX 1024   // 接收表中更长的主题另行分配, 不超过此长度
+
+typedef struct {
+    char topic[MQTT_TOPIC_ALIAS_TOPIC_LEN];
+    char *long_topic;              // 超过 MQTT_TOPIC_ALIAS_TOPIC_LEN 的主题, 只有接收表使用
+    uint16_t topic_len;            // 0 表示空闲
+    uint32_t last_used;
+} mqtt_topic_alias_entry_t;
+
+typedef struct {
+    mqtt_topic_alias_entry_t entries[MQTT_TOPIC_ALIAS_MAX];
+    uint16_t capacity;             // 本次连接可用的别名数
+    uint32_t clock;
+} mqtt_topic_alias_table_t;
+
+// 清空表并释放另行分配的主题, capacity 取对端 Topic Alias Maximum 与 MQTT_TOPIC_ALIAS_MAX 的较小值
+void mqtt_topic_alias_reset(mqtt_topic_alias_table_t *table, uint16_t maximum);
+// 返回主题已建立的别名, 没有返回 0
+uint16_t mqtt_topic_alias_find(mqtt_topic_alias_table_t *table, const char *topic, uint16_t topic_len);
+// 返回可分配给新主题的别名 (空闲或最久未用), 禁用或主题过长时返回 0
+uint16_t mqtt_topic_alias_victim(mqtt_topic_alias_table_t *table, uint16_t topic_len);
+// 登记别名与主题的对应关系, 失败时该别名原有的对应关系一并清除
+bool mqtt_topic_alias_set(mqtt_topic_alias_table_t *table, uint16_t alias,
+                         const char *topic, uint16_t topic_len);
+// 接收时把别名解析为主题, 未知别名返回 NULL
+const char *mqtt_topic_alias_resolve(mqtt_topic_alias_table_t *table, uint16_t alias,
+                                    uint16_t *topic_len);
+
+#endif /* MQTT_TOPIC_ALIAS_H */
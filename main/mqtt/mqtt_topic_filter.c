@@ -0,0 +1,42 @@
+#include "mqtt_topic_filter.h"
+
+bool mqtt_topic_filter_match(const char *filter, const char *topic, uint16_t topic_len,
+                             uint16_t *tail) {
+    uint16_t pos = 0;
+
+    if (topic_len > 0 && topic[0] == '$' && (filter[0] == '+' || filter[0] == '#')) {
+        return false;
+    }
+
+    while (*filter) {
+        if (filter[0] == '#') {
+            break;
+        }
+        if (filter[0] == '+') {
+            while (pos < topic_len && topic[pos] != '/') {
+                pos++;
+            }
+            filter++;
+            continue;
+        }
+        if (pos == topic_len) {
+            if (filter[0] == '/' && filter[1] == '#') {
+                break;
+            }
+            return false;
+        }
+        if (topic[pos] != filter[0]) {
+            return false;
+        }
+        pos++;
+        filter++;
+    }
+
+    if (*filter == '\0' && pos != topic_len) {
+        return false;
+    }
+    if (tail) {
+        *tail = *filter == '\0' ? topic_len : pos;
+    }
+    return true;
+}
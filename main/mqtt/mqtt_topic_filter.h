@@ -0,0 +1,16 @@
+#ifndef MQTT_TOPIC_FILTER_H
+#define MQTT_TOPIC_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// MQTT 主题过滤器匹配, 桥接的路由表和发布压缩规则共用
+// '+' 匹配一级, '#' 匹配其余所有级 (包括父级本身, "a/#" 也匹配 "a");
+// '$' 开头的系统主题不匹配首级通配符
+
+// topic 不要求以 '\0' 结尾. tail 可为 NULL; 匹配到 '#' 时 *tail 为其匹配部分在 topic 中的偏移,
+// 否则为 topic_len
+bool mqtt_topic_filter_match(const char *filter, const char *topic, uint16_t topic_len,
+                             uint16_t *tail);
+
+#endif /* MQTT_TOPIC_FILTER_H */
@@ -0,0 +1,109 @@
+#include "mqtt_tx.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <string.h>
+
+void mqtt_tx_init(mqtt_tx_batch_t *batch, uint8_t *buf, uint32_t capacity) {
+    batch->buf = buf;
+    batch->capacity = capacity;
+    mqtt_tx_reset(batch);
+}
+
+void mqtt_tx_reset(mqtt_tx_batch_t *batch) {
+    batch->used = 0;
+    batch->iov_count = 0;
+    batch->bytes = 0;
+}
+
+// 最后一个 iovec 是否以发送缓冲区的末尾结束, 是则可以直接延长
+static bool tail_is_buffered(const mqtt_tx_batch_t *batch) {
+    if (batch->iov_count == 0) {
+        return false;
+    }
+    const struct iovec *last = &batch->iov[batch->iov_count - 1];
+    return (uint8_t *)last->iov_base + last->iov_len == batch->buf + batch->used;
+}
+
+uint8_t *mqtt_tx_reserve(mqtt_tx_batch_t *batch, uint32_t *space) {
+    if (!tail_is_buffered(batch) && batch->iov_count == MQTT_TX_MAX_IOV) {
+        *space = 0;
+    } else {
+        *space = batch->capacity - batch->used;
+    }
+    return batch->buf + batch->used;
+}
+
+void mqtt_tx_commit(mqtt_tx_batch_t *batch, uint32_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (tail_is_buffered(batch)) {
+        batch->iov[batch->iov_count - 1].iov_len += len;
+    } else {
+        struct iovec *iov = &batch->iov[batch->iov_count++];
+        iov->iov_base = batch->buf + batch->used;
+        iov->iov_len = len;
+    }
+    batch->used += len;
+    batch->bytes += len;
+}
+
+bool mqtt_tx_append(mqtt_tx_batch_t *batch, const void *data, uint32_t len) {
+    if (len == 0) {
+        return true;
+    }
+
+    if (len <= MQTT_TX_COPY_THRESHOLD) {
+        uint32_t space;
+        uint8_t *dst = mqtt_tx_reserve(batch, &space);
+        if (space >= len) {
+            memcpy(dst, data, len);
+            mqtt_tx_commit(batch, len);
+            return true;
+        }
+    }
+
+    if (batch->iov_count == MQTT_TX_MAX_IOV) {
+        return false;
+    }
+    struct iovec *iov = &batch->iov[batch->iov_count++];
+    iov->iov_base = (void *)data;
+    iov->iov_len = len;
+    batch->bytes += len;
+    return true;
+}
+
+int mqtt_tx_flush(mqtt_tx_batch_t *batch, int fd) {
+    struct iovec *iov = batch->iov;
+    int iov_count = batch->iov_count;
+    int ret = 0;
+
+    while (iov_count > 0) {
+        struct msghdr msg = {
+            .msg_iov = iov,
+            .msg_iovlen = iov_count
+        };
+        ssize_t sent = sendmsg(fd, &msg, 0);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret = -1;
+            break;
+        }
+
+        // 跳过已完整写出的 iovec, 部分写出的调整起点
+        while (iov_count > 0 && (size_t)sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+
+    mqtt_tx_reset(batch);
+    return ret;
+}
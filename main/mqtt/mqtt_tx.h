@@ -0,0 +1,40 @@
+#ifndef MQTT_TX_H
+#define MQTT_TX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+// MQTT 发送批次
+// 多个包先追加到批次中, 再用一次 sendmsg 写出
+// 头部和小载荷复制到连续的发送缓冲区, 大载荷以 iovec 直接引用调用者的缓冲区
+
+#define MQTT_TX_MAX_IOV           16
+#define MQTT_TX_COPY_THRESHOLD    128   // 不超过该长度的载荷直接复制
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t capacity;
+    uint32_t used;                 // 发送缓冲区已用字节
+    struct iovec iov[MQTT_TX_MAX_IOV];
+    int iov_count;
+    uint32_t bytes;                // 批次总字节数
+} mqtt_tx_batch_t;
+
+void mqtt_tx_init(mqtt_tx_batch_t *batch, uint8_t *buf, uint32_t capacity);
+void mqtt_tx_reset(mqtt_tx_batch_t *batch);
+
+// 返回发送缓冲区中可直接编码的位置及可用字节数, 无法再追加时 space 为 0
+uint8_t *mqtt_tx_reserve(mqtt_tx_batch_t *batch, uint32_t *space);
+// 提交编码到 mqtt_tx_reserve() 位置的字节
+void mqtt_tx_commit(mqtt_tx_batch_t *batch, uint32_t len);
+// 追加外部数据, 大数据只记录引用, 数据必须保持有效直到 mqtt_tx_flush() 返回
+bool mqtt_tx_append(mqtt_tx_batch_t *batch, const void *data, uint32_t len);
+// 写出整个批次并清空, 失败返回 -1
+int mqtt_tx_flush(mqtt_tx_batch_t *batch, int fd);
+
+static inline bool mqtt_tx_empty(const mqtt_tx_batch_t *batch) {
+    return batch->bytes == 0;
+}
+
+#endif /* MQTT_TX_H */
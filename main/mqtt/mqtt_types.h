@@ -4,6 +4,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// 剩余长度最大值 (4 字节变长编码)
+#define MQTT_MAX_REMAINING_LENGTH 268435455
+
+// 协议级别
+#define MQTT_PROTOCOL_V311 4
+#define MQTT_PROTOCOL_V5   5
+
 // MQTT 控制包类型
 typedef enum {
     MQTT_CONNECT     = 1,  // 客户端请求连接服务端
@@ -55,6 +62,8 @@ typedef struct {
     const char *username;
     const char *password;
     uint16_t keep_alive;
+    // false 时服务端保留会话 (MQTT 5.0 还需设置 v5.session_expiry),
+    // 重连恢复会话后不重新订阅, 未确认的 QoS 1/2 消息立即以 DUP 标志重发
     bool clean_session;
     struct {
         const char *topic;
@@ -62,6 +71,14 @@ typedef struct {
         mqtt_qos_t qos;
         bool retain;
     } will;
+    uint8_t protocol_version;      // MQTT_PROTOCOL_V311 或 MQTT_PROTOCOL_V5, 0 按 3.1.1 处理
+    // MQTT 5.0 CONNECT 属性, 0 表示不发送
+    struct {
+        uint32_t session_expiry;
+        uint16_t receive_maximum;          // 总是发送, 0 或超过 QoS 2 接收表容量时取容量
+        uint32_t maximum_packet_size;
+        uint16_t topic_alias_maximum;
+    } v5;
 } mqtt_connect_options_t;
 
 // MQTT 主题过滤器
@@ -71,8 +88,13 @@ typedef struct {
 } mqtt_topic_filter_t;
 
 // MQTT 消息
+// 解码得到的消息是指向接收缓冲区的视图: topic 不以 '\0' 结尾, 长度由 topic_len 给出,
+// 仅在回调期间有效, 需要保留时调用 mqtt_message_retain()
+// 发送时 topic_len 为 0 表示 topic 是以 '\0' 结尾的字符串
 typedef struct {
     const char *topic;
+    uint16_t topic_len;
+    uint16_t packet_id;
     const uint8_t *payload;
     uint32_t payload_len;
     mqtt_qos_t qos;
@@ -0,0 +1,268 @@
+#include "mqtt_bridge.h"
+#include "memory_pool.h"
+#include "mqtt/mqtt_client.h"
+#include "mqtt/mqtt_topic_filter.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+#define TAG "MQTT_BRIDGE"
+
+typedef struct {
+    char remote_filter[MQTT_BRIDGE_FILTER_LEN];
+    char local_topic[MAX_TOPIC_NAME_LENGTH];   // 空字符串表示同名
+    bool append_tail;              // local_topic 是前缀, 后接 '#' 匹配的部分
+    uint8_t qos;
+    msg_priority_t priority;
+} bridge_route_t;
+
+static struct {
+    bridge_route_t routes[MQTT_BRIDGE_MAX_ROUTES];
+    uint32_t route_count;
+    TickType_t block_ticks;
+    mqtt_bridge_stats_t stats;
+    struct {
+        bool active;
+        uint8_t *data;
+        uint32_t total_len;
+        uint32_t received;
+        char local_topic[MAX_TOPIC_NAME_LENGTH];
+        msg_priority_t priority;
+    } stream;                      // 只有接收任务访问
+    portMUX_TYPE mux;
+} bridge_ctx = { .mux = portMUX_INITIALIZER_UNLOCKED };
+
+// 查找第一个匹配的路由并生成本地主题名
+static const bridge_route_t *route_lookup(const char *topic, uint16_t topic_len, char *local_topic) {
+    uint32_t count = bridge_ctx.route_count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const bridge_route_t *route = &bridge_ctx.routes[i];
+        uint16_t tail;
+        if (!mqtt_topic_filter_match(route->remote_filter, topic, topic_len, &tail)) {
+            continue;
+        }
+
+        if (route->local_topic[0] == '\0') {
+            if (topic_len >= MAX_TOPIC_NAME_LENGTH) {
+                return NULL;
+            }
+            memcpy(local_topic, topic, topic_len);
+            local_topic[topic_len] = '\0';
+        } else if (route->append_tail) {
+            size_t prefix_len = strlen(route->local_topic);
+            uint16_t tail_len = topic_len - tail;
+            // '#' 匹配为空时去掉前缀末尾的 '/'
+            if (tail_len == 0 && prefix_len > 0) {
+                prefix_len--;
+            }
+            if (prefix_len + tail_len >= MAX_TOPIC_NAME_LENGTH) {
+                return NULL;
+            }
+            memcpy(local_topic, route->local_topic, prefix_len);
+            memcpy(local_topic + prefix_len, topic + tail, tail_len);
+            local_topic[prefix_len + tail_len] = '\0';
+        } else {
+            strcpy(local_topic, route->local_topic);
+        }
+        return route;
+    }
+    return NULL;
+}
+
+static void stats_add(uint32_t *counter) {
+    portENTER_CRITICAL(&bridge_ctx.mux);
+    (*counter)++;
+    portEXIT_CRITICAL(&bridge_ctx.mux);
+}
+
+// 把内存池中的载荷转交本地主题, 失败时释放
+static esp_err_t hand_off(const char *local_topic, uint8_t *data, uint32_t len,
+                          msg_priority_t priority) {
+    pubsub_err_t err = pubsub_publish_owned(local_topic, data, len, priority,
+                                            bridge_ctx.block_ticks);
+    if (err != PUBSUB_OK) {
+        if (data != NULL) {
+            memory_pool_free(data);
+        }
+        stats_add(&bridge_ctx.stats.dropped);
+        ESP_LOGW(TAG, "Dropped %u bytes for %s: %d", (unsigned)len, local_topic, err);
+        return err == PUBSUB_ERR_QUEUE_FULL ? ESP_ERR_TIMEOUT : ESP_FAIL;
+    }
+    stats_add(&bridge_ctx.stats.delivered);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_bridge_init(const mqtt_bridge_config_t *config) {
+    portENTER_CRITICAL(&bridge_ctx.mux);
+    bridge_ctx.route_count = 0;
+    bridge_ctx.block_ticks = config ? config->block_ticks : 0;
+    memset(&bridge_ctx.stats, 0, sizeof(mqtt_bridge_stats_t));
+    portEXIT_CRITICAL(&bridge_ctx.mux);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_bridge_add_route(const mqtt_bridge_route_t *route) {
+    if (route == NULL || route->remote_filter == NULL ||
+        strlen(route->remote_filter) >= MQTT_BRIDGE_FILTER_LEN ||
+        (route->local_topic && strlen(route->local_topic) >= MAX_TOPIC_NAME_LENGTH)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bridge_route_t entry;
+    memset(&entry, 0, sizeof(bridge_route_t));
+    strcpy(entry.remote_filter, route->remote_filter);
+    if (route->local_topic) {
+        size_t local_len = strlen(route->local_topic);
+        size_t filter_len = strlen(route->remote_filter);
+        if (local_len >= 2 && strcmp(route->local_topic + local_len - 2, "/#") == 0 &&
+            route->remote_filter[filter_len - 1] == '#') {
+            // 只保留前缀 (含末尾的 '/')
+            memcpy(entry.local_topic, route->local_topic, local_len - 1);
+            entry.append_tail = true;
+        } else {
+            strcpy(entry.local_topic, route->local_topic);
+        }
+    }
+    entry.qos = route->qos;
+    entry.priority = route->priority;
+
+    portENTER_CRITICAL(&bridge_ctx.mux);
+    if (bridge_ctx.route_count >= MQTT_BRIDGE_MAX_ROUTES) {
+        portEXIT_CRITICAL(&bridge_ctx.mux);
+        return ESP_ERR_NO_MEM;
+    }
+    bridge_ctx.routes[bridge_ctx.route_count] = entry;
+    bridge_ctx.route_count++;
+    portEXIT_CRITICAL(&bridge_ctx.mux);
+    return ESP_OK;
+}
+
+void mqtt_bridge_foreach_filter(mqtt_bridge_filter_fn_t fn, void *arg) {
+    uint32_t count = bridge_ctx.route_count;
+    for (uint32_t i = 0; i < count; i++) {
+        fn(bridge_ctx.routes[i].remote_filter, bridge_ctx.routes[i].qos, arg);
+    }
+}
+
+esp_err_t mqtt_bridge_deliver(const char *topic, uint16_t topic_len,
+                              const uint8_t *payload, uint32_t payload_len) {
+    char local_topic[MAX_TOPIC_NAME_LENGTH];
+    const bridge_route_t *route = route_lookup(topic, topic_len, local_topic);
+    if (route == NULL) {
+        stats_add(&bridge_ctx.stats.unmatched);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 接收缓冲区会被下一个包复用, 这是唯一的一次复制
+    uint8_t *data = NULL;
+    if (payload_len > 0) {
+        data = memory_pool_alloc(payload_len);
+        if (data == NULL) {
+            stats_add(&bridge_ctx.stats.dropped);
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(data, payload, payload_len);
+    }
+    return hand_off(local_topic, data, payload_len, route->priority);
+}
+
+esp_err_t mqtt_bridge_begin(const char *topic, uint16_t topic_len, uint32_t total_len) {
+    if (bridge_ctx.stream.active) {
+        mqtt_bridge_end(false);
+    }
+
+    const bridge_route_t *route = route_lookup(topic, topic_len, bridge_ctx.stream.local_topic);
+    if (route == NULL) {
+        stats_add(&bridge_ctx.stats.unmatched);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // 片段直接写入最终的载荷缓冲区
+    bridge_ctx.stream.data = total_len > 0 ? memory_pool_alloc(total_len) : NULL;
+    if (total_len > 0 && bridge_ctx.stream.data == NULL) {
+        stats_add(&bridge_ctx.stats.dropped);
+        return ESP_ERR_NO_MEM;
+    }
+    bridge_ctx.stream.active = true;
+    bridge_ctx.stream.total_len = total_len;
+    bridge_ctx.stream.received = 0;
+    bridge_ctx.stream.priority = route->priority;
+    return ESP_OK;
+}
+
+esp_err_t mqtt_bridge_chunk(const uint8_t *data, uint32_t len, uint32_t offset) {
+    if (!bridge_ctx.stream.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (offset > bridge_ctx.stream.total_len || len > bridge_ctx.stream.total_len - offset) {
+        mqtt_bridge_end(false);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(bridge_ctx.stream.data + offset, data, len);
+    bridge_ctx.stream.received += len;
+    return ESP_OK;
+}
+
+esp_err_t mqtt_bridge_end(bool complete) {
+    if (!bridge_ctx.stream.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    bridge_ctx.stream.active = false;
+
+    if (!complete || bridge_ctx.stream.received != bridge_ctx.stream.total_len) {
+        if (bridge_ctx.stream.data != NULL) {
+            memory_pool_free(bridge_ctx.stream.data);
+        }
+        stats_add(&bridge_ctx.stats.dropped);
+        return ESP_FAIL;
+    }
+    return hand_off(bridge_ctx.stream.local_topic, bridge_ctx.stream.data,
+                    bridge_ctx.stream.total_len, bridge_ctx.stream.priority);
+}
+
+static void client_stream_begin(const mqtt_message_t *message, uint32_t total_len, void *arg) {
+    mqtt_bridge_begin(message->topic, message->topic_len, total_len);
+}
+
+static void client_stream_chunk(const uint8_t *data, uint32_t len, uint32_t offset, void *arg) {
+    if (bridge_ctx.stream.active) {
+        mqtt_bridge_chunk(data, len, offset);
+    }
+}
+
+static void client_stream_end(bool complete, void *arg) {
+    if (bridge_ctx.stream.active) {
+        mqtt_bridge_end(complete);
+    }
+}
+
+static void client_subscribe(const char *remote_filter, uint8_t qos, void *arg) {
+    esp_err_t err = mqtt_client_subscribe(remote_filter, qos);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to subscribe %s: %d", remote_filter, err);
+    }
+}
+
+esp_err_t mqtt_bridge_attach_client(void) {
+    static const mqtt_stream_handler_t handler = {
+        .begin = client_stream_begin,
+        .chunk = client_stream_chunk,
+        .end = client_stream_end
+    };
+
+    esp_err_t err = mqtt_client_set_stream_handler(&handler);
+    if (err != ESP_OK) {
+        return err;
+    }
+    // 客户端登记订阅, 重连后自动重新订阅
+    mqtt_bridge_foreach_filter(client_subscribe, NULL);
+    return ESP_OK;
+}
+
+void mqtt_bridge_get_stats(mqtt_bridge_stats_t *stats) {
+    portENTER_CRITICAL(&bridge_ctx.mux);
+    *stats = bridge_ctx.stats;
+    portEXIT_CRITICAL(&bridge_ctx.mux);
+}
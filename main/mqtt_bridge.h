@@ -0,0 +1,56 @@
+#ifndef MQTT_BRIDGE_H
+#define MQTT_BRIDGE_H
+
+#include "esp_err.h"
+#include "pubsub_core.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 入站桥接: 服务端 PUBLISH 按路由表注入本地主题队列
+// 载荷从接收缓冲区复制一次到内存池后直接转交主题队列, 由主题任务释放, 不再经过 pubsub_publish 的第二次复制
+// 本地队列满时在接收任务中最多阻塞 block_ticks, 接收停顿后 TCP 窗口收紧, 由服务端承受背压
+// 路由应在连接前配置完成
+
+#define MQTT_BRIDGE_MAX_ROUTES 16
+#define MQTT_BRIDGE_FILTER_LEN 128
+
+// 路由: remote_filter 支持 '+' 和 '#' 通配符
+// local_topic 为 NULL 时使用同名本地主题; 以 "/#" 结尾且 remote_filter 也以 '#' 结尾时,
+// 服务端主题中 '#' 匹配的部分接在 local_topic 前缀之后
+typedef struct {
+    const char *remote_filter;
+    const char *local_topic;
+    uint8_t qos;                   // 向服务端订阅时使用的 QoS
+    msg_priority_t priority;
+} mqtt_bridge_route_t;
+
+typedef struct {
+    TickType_t block_ticks;        // 本地队列满时阻塞接收任务的最长时间, 0 表示直接丢弃
+} mqtt_bridge_config_t;
+
+typedef struct {
+    uint32_t delivered;
+    uint32_t unmatched;            // 没有匹配路由的消息
+    uint32_t dropped;              // 内存不足、超出预算或队列满被丢弃的消息
+} mqtt_bridge_stats_t;
+
+// 遍历路由的服务端过滤器, 用于连接建立后订阅
+typedef void (*mqtt_bridge_filter_fn_t)(const char *remote_filter, uint8_t qos, void *arg);
+
+// 入站桥接API
+esp_err_t mqtt_bridge_init(const mqtt_bridge_config_t *config);
+esp_err_t mqtt_bridge_add_route(const mqtt_bridge_route_t *route);
+void mqtt_bridge_foreach_filter(mqtt_bridge_filter_fn_t fn, void *arg);
+// 完整消息, topic 不要求以 '\0' 结尾
+esp_err_t mqtt_bridge_deliver(const char *topic, uint16_t topic_len,
+                              const uint8_t *payload, uint32_t payload_len);
+// 分片到达的大消息: begin 之后按顺序 chunk, 最后 end; complete 为 false 时丢弃
+esp_err_t mqtt_bridge_begin(const char *topic, uint16_t topic_len, uint32_t total_len);
+esp_err_t mqtt_bridge_chunk(const uint8_t *data, uint32_t len, uint32_t offset);
+esp_err_t mqtt_bridge_end(bool complete);
+// 接入 mqtt/ 下的客户端: 订阅所有路由并设置大包流式处理器
+// 普通消息仍需在客户端回调的 MQTT_EVENT_MESSAGE 中调用 mqtt_bridge_deliver
+esp_err_t mqtt_bridge_attach_client(void);
+void mqtt_bridge_get_stats(mqtt_bridge_stats_t *stats);
+
+#endif /* MQTT_BRIDGE_H */
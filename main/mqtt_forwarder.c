@@ -0,0 +1,311 @@
+#include "mqtt_forwarder.h"
+#include "network_layer.h"
+#include "pubsub_core.h"
+#include "memory_pool.h"
+#include "memory_budget.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <string.h>
+
+#define TAG "MQTT_FORWARDER"
+#define FORWARDER_TASK_STACK_SIZE 4096
+#define FORWARDER_TASK_PRIORITY 5
+#define FORWARDER_DEFAULT_QUEUE_SIZE 32
+#define FORWARDER_RETRY_MS 1000           // 发送失败后重试间隔
+#define FORWARDER_REMOTE_TOPIC_LEN 128
+#define MILLI_TOKENS 1000                 // 令牌以千分之一为单位计数
+
+// 订阅回调交给转发任务的消息, data 在内存池中并计入来源主题的内存预算
+typedef struct {
+    uint32_t route;
+    uint8_t *data;
+    uint32_t len;
+} forward_item_t;
+
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+} pending_t;
+
+typedef struct {
+    char local_topic[MAX_TOPIC_NAME_LENGTH];
+    char remote_topic[FORWARDER_REMOTE_TOPIC_LEN];
+    uint8_t qos;
+    bool retain;
+    uint32_t budget_index;         // 本地主题在 pubsub 主题表中的位置
+    uint32_t rate_per_sec;
+    uint32_t burst_milli;
+    int64_t batch_window_us;
+    // 以下只由转发任务访问
+    uint32_t tokens_milli;
+    int64_t last_refill_us;
+    int64_t batch_start_us;        // 本批第一条消息到达的时间
+    int64_t retry_at_us;
+    pending_t pending[MQTT_FORWARDER_ROUTE_QUEUE];
+    uint8_t head;
+    uint8_t count;
+} forward_route_t;
+
+static struct {
+    forward_route_t routes[MQTT_FORWARDER_MAX_ROUTES];
+    uint32_t route_count;
+    mqtt_forwarder_send_t send;
+    QueueHandle_t queue;
+    TaskHandle_t task_handle;
+    mqtt_forwarder_stats_t stats;
+    portMUX_TYPE mux;
+} forwarder_ctx = { .mux = portMUX_INITIALIZER_UNLOCKED };
+
+static void stats_add(uint32_t *counter) {
+    portENTER_CRITICAL(&forwarder_ctx.mux);
+    (*counter)++;
+    portEXIT_CRITICAL(&forwarder_ctx.mux);
+}
+
+// 缩短等待时间, wait_us 为 -1 表示无限等待
+static void wait_at_most(int64_t *wait_us, int64_t candidate_us) {
+    if (candidate_us < 0) {
+        candidate_us = 0;
+    }
+    if (*wait_us < 0 || candidate_us < *wait_us) {
+        *wait_us = candidate_us;
+    }
+}
+
+// 释放载荷副本并归还内存预算
+static void forward_free(const forward_route_t *route, uint8_t *data, uint32_t len) {
+    if (data != NULL) {
+        memory_pool_free(data);
+        memory_budget_release(route->budget_index, len);
+    }
+}
+
+// 本地订阅回调, 在主题任务中执行: 复制载荷后交给转发任务, 不阻塞
+// 副本按原消息的优先级做预算准入, 排队的转发不会占用留给 CRITICAL 消息的余量
+static void forward_callback(const pubsub_msg_t *msg, void *user_data) {
+    forward_item_t item = {
+        .route = (uint32_t)(uintptr_t)user_data,
+        .data = NULL,
+        .len = msg->data_len
+    };
+    const forward_route_t *route = &forwarder_ctx.routes[item.route];
+
+    if (msg->data_len > 0) {
+        if (!memory_budget_admit(route->budget_index, msg->data_len, msg->priority)) {
+            stats_add(&forwarder_ctx.stats.dropped);
+            return;
+        }
+        item.data = memory_pool_alloc(msg->data_len);
+        if (item.data == NULL) {
+            memory_budget_release(route->budget_index, msg->data_len);
+            stats_add(&forwarder_ctx.stats.dropped);
+            return;
+        }
+        memcpy(item.data, msg->data, msg->data_len);
+    }
+
+    if (xQueueSend(forwarder_ctx.queue, &item, 0) != pdTRUE) {
+        forward_free(route, item.data, item.len);
+        stats_add(&forwarder_ctx.stats.dropped);
+    }
+}
+
+// 消息加入路由队列, 已满时丢弃最旧的消息
+static void route_enqueue(forward_route_t *route, const forward_item_t *item, int64_t now_us) {
+    if (route->count == MQTT_FORWARDER_ROUTE_QUEUE) {
+        pending_t *oldest = &route->pending[route->head];
+        forward_free(route, oldest->data, oldest->len);
+        route->head = (route->head + 1) % MQTT_FORWARDER_ROUTE_QUEUE;
+        route->count--;
+        stats_add(&forwarder_ctx.stats.dropped);
+    }
+    if (route->count == 0) {
+        route->batch_start_us = now_us;
+    }
+
+    pending_t *slot = &route->pending[(route->head + route->count) % MQTT_FORWARDER_ROUTE_QUEUE];
+    slot->data = item->data;
+    slot->len = item->len;
+    route->count++;
+}
+
+// 按经过的时间补充令牌
+static void route_refill(forward_route_t *route, int64_t now_us) {
+    uint64_t added = (uint64_t)(now_us - route->last_refill_us) * route->rate_per_sec / 1000;
+    route->last_refill_us = now_us;
+    if (added >= route->burst_milli - route->tokens_milli) {
+        route->tokens_milli = route->burst_milli;
+    } else {
+        route->tokens_milli += added;
+    }
+}
+
+// 批量窗口结束后在令牌允许的范围内发出排队的消息, 返回前更新下一次需要处理的时间
+static void route_service(forward_route_t *route, int64_t now_us, int64_t *wait_us) {
+    if (route->count == 0) {
+        return;
+    }
+    if (now_us < route->batch_start_us + route->batch_window_us) {
+        wait_at_most(wait_us, route->batch_start_us + route->batch_window_us - now_us);
+        return;
+    }
+    if (now_us < route->retry_at_us) {
+        wait_at_most(wait_us, route->retry_at_us - now_us);
+        return;
+    }
+
+    if (route->rate_per_sec > 0) {
+        route_refill(route, now_us);
+    }
+
+    while (route->count > 0) {
+        if (route->rate_per_sec > 0 && route->tokens_milli < MILLI_TOKENS) {
+            uint64_t missing = MILLI_TOKENS - route->tokens_milli;
+            wait_at_most(wait_us, (missing * 1000 + route->rate_per_sec - 1) / route->rate_per_sec);
+            return;
+        }
+
+        pending_t *msg = &route->pending[route->head];
+        esp_err_t err = forwarder_ctx.send(route->remote_topic, msg->data, msg->len,
+                                           route->qos, route->retain);
+        if (err != ESP_OK) {
+            // 保留消息, 稍后重试
+            stats_add(&forwarder_ctx.stats.send_failures);
+            route->retry_at_us = now_us + (int64_t)FORWARDER_RETRY_MS * 1000;
+            wait_at_most(wait_us, (int64_t)FORWARDER_RETRY_MS * 1000);
+            return;
+        }
+
+        forward_free(route, msg->data, msg->len);
+        route->head = (route->head + 1) % MQTT_FORWARDER_ROUTE_QUEUE;
+        route->count--;
+        if (route->rate_per_sec > 0) {
+            route->tokens_milli -= MILLI_TOKENS;
+        }
+        stats_add(&forwarder_ctx.stats.forwarded);
+    }
+}
+
+// 转发任务: 阻塞在队列上, 超时时间取所有路由中最近的窗口结束、令牌补充或重试时间
+static void forwarder_task(void *arg) {
+    forward_item_t item;
+    TickType_t wait_ticks = portMAX_DELAY;
+
+    while (1) {
+        if (xQueueReceive(forwarder_ctx.queue, &item, wait_ticks) == pdTRUE) {
+            int64_t now_us = esp_timer_get_time();
+            do {
+                route_enqueue(&forwarder_ctx.routes[item.route], &item, now_us);
+            } while (xQueueReceive(forwarder_ctx.queue, &item, 0) == pdTRUE);
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        int64_t wait_us = -1;
+        uint32_t count = forwarder_ctx.route_count;
+        for (uint32_t i = 0; i < count; i++) {
+            route_service(&forwarder_ctx.routes[i], now_us, &wait_us);
+        }
+
+        if (wait_us < 0) {
+            wait_ticks = portMAX_DELAY;
+        } else {
+            wait_ticks = pdMS_TO_TICKS((wait_us + 999) / 1000);
+            if (wait_ticks == 0) {
+                wait_ticks = 1;
+            }
+        }
+    }
+}
+
+esp_err_t mqtt_forwarder_init(const mqtt_forwarder_config_t *config) {
+    if (forwarder_ctx.queue != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t queue_size = FORWARDER_DEFAULT_QUEUE_SIZE;
+    forwarder_ctx.send = network_publish;
+    if (config != NULL) {
+        if (config->send != NULL) {
+            forwarder_ctx.send = config->send;
+        }
+        if (config->queue_size > 0) {
+            queue_size = config->queue_size;
+        }
+    }
+
+    forwarder_ctx.queue = xQueueCreate(queue_size, sizeof(forward_item_t));
+    if (forwarder_ctx.queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreate(forwarder_task, "mqtt_forwarder",
+                                 FORWARDER_TASK_STACK_SIZE, NULL,
+                                 FORWARDER_TASK_PRIORITY, &forwarder_ctx.task_handle);
+    if (ret != pdPASS) {
+        vQueueDelete(forwarder_ctx.queue);
+        forwarder_ctx.queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_forwarder_add_route(const mqtt_forwarder_route_t *route) {
+    if (forwarder_ctx.queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (route == NULL || route->local_topic == NULL || route->qos > 2 ||
+        strlen(route->local_topic) >= MAX_TOPIC_NAME_LENGTH ||
+        (route->remote_topic && strlen(route->remote_topic) >= FORWARDER_REMOTE_TOPIC_LEN)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&forwarder_ctx.mux);
+    uint32_t index = forwarder_ctx.route_count;
+    portEXIT_CRITICAL(&forwarder_ctx.mux);
+    if (index >= MQTT_FORWARDER_MAX_ROUTES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    forward_route_t *entry = &forwarder_ctx.routes[index];
+    memset(entry, 0, sizeof(forward_route_t));
+    strcpy(entry->local_topic, route->local_topic);
+    strcpy(entry->remote_topic, route->remote_topic ? route->remote_topic : route->local_topic);
+    entry->qos = route->qos;
+    entry->retain = route->retain;
+    entry->rate_per_sec = route->rate_per_sec;
+    entry->burst_milli = (route->burst > 0 ? route->burst : 1) * MILLI_TOKENS;
+    entry->tokens_milli = entry->burst_milli;
+    entry->batch_window_us = (int64_t)route->batch_window_ms * 1000;
+    entry->last_refill_us = esp_timer_get_time();
+
+    // 条目填好后再订阅; 订阅失败时不计入路由数, 槽位留给下一条路由
+    int budget_index = pubsub_get_topic_index(entry->local_topic);
+    if (budget_index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    entry->budget_index = budget_index;
+
+    pubsub_err_t err = pubsub_subscribe(entry->local_topic, forward_callback, (void *)(uintptr_t)index);
+    if (err != PUBSUB_OK) {
+        ESP_LOGE(TAG, "Failed to subscribe local topic %s: %d", entry->local_topic, err);
+        return err == PUBSUB_ERR_TOPIC_NOT_FOUND ? ESP_ERR_NOT_FOUND : ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&forwarder_ctx.mux);
+    forwarder_ctx.route_count = index + 1;
+    portEXIT_CRITICAL(&forwarder_ctx.mux);
+
+    ESP_LOGI(TAG, "Forwarding %s -> %s (qos %u, %u msg/s, window %u ms)",
+             entry->local_topic, entry->remote_topic, entry->qos,
+             (unsigned)route->rate_per_sec, (unsigned)route->batch_window_ms);
+    return ESP_OK;
+}
+
+void mqtt_forwarder_get_stats(mqtt_forwarder_stats_t *stats) {
+    portENTER_CRITICAL(&forwarder_ctx.mux);
+    *stats = forwarder_ctx.stats;
+    portEXIT_CRITICAL(&forwarder_ctx.mux);
+}
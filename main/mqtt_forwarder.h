@@ -0,0 +1,48 @@
+#ifndef MQTT_FORWARDER_H
+#define MQTT_FORWARDER_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 出站转发: 按路由表把本地主题的消息发布到服务端
+// 单个转发任务处理所有路由. 每条路由有独立的令牌桶限速和批量窗口:
+// 窗口内到达的消息攒在一起, 窗口结束后在令牌允许的范围内连续发出, 超出速率的消息排队等待令牌,
+// 排队已满时丢弃最旧的消息, 高频主题不会占满上行链路
+
+#define MQTT_FORWARDER_MAX_ROUTES 16
+#define MQTT_FORWARDER_ROUTE_QUEUE 16     // 每条路由最多排队的消息数
+
+typedef struct {
+    const char *local_topic;
+    const char *remote_topic;      // NULL 表示与本地主题同名
+    uint8_t qos;
+    bool retain;
+    uint32_t rate_per_sec;         // 令牌补充速率, 0 表示不限速
+    uint32_t burst;                // 令牌桶容量, 0 按 1 处理
+    uint32_t batch_window_ms;      // 0 表示消息到达后立即发送
+} mqtt_forwarder_route_t;
+
+// 发布函数, 未连接或发送失败时返回错误, 消息留在队列中稍后重试
+typedef esp_err_t (*mqtt_forwarder_send_t)(const char *topic, const uint8_t *data, size_t len,
+                                           uint8_t qos, bool retain);
+
+typedef struct {
+    mqtt_forwarder_send_t send;    // NULL 时使用 network_publish
+    uint32_t queue_size;           // 本地订阅回调到转发任务的队列长度, 0 使用默认值
+} mqtt_forwarder_config_t;
+
+typedef struct {
+    uint32_t forwarded;
+    uint32_t dropped;              // 排队溢出、内存不足或超出来源主题内存预算丢弃的消息
+    uint32_t send_failures;
+} mqtt_forwarder_stats_t;
+
+// 出站转发API
+esp_err_t mqtt_forwarder_init(const mqtt_forwarder_config_t *config);
+// 订阅本地主题, 主题必须已创建. 路由在启动时由同一个任务添加
+esp_err_t mqtt_forwarder_add_route(const mqtt_forwarder_route_t *route);
+void mqtt_forwarder_get_stats(mqtt_forwarder_stats_t *stats);
+
+#endif /* MQTT_FORWARDER_H */
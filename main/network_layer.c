@@ -1,4 +1,6 @@
 #include "network_layer.h"
+#include "mqtt_bridge.h"
+#include "offline_store.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -36,6 +38,32 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
     }
 }
 
+// 订阅入站桥接的服务端主题过滤器
+static void subscribe_bridge_filter(const char *remote_filter, uint8_t qos, void *arg) {
+    if (esp_mqtt_client_subscribe(mqtt_client, remote_filter, qos) < 0) {
+        ESP_LOGE(TAG, "MQTT subscribe failed: %s", remote_filter);
+    }
+}
+
+// 入站消息交给桥接, 超过接收缓冲区的消息分多次事件到达
+static void handle_mqtt_data(esp_mqtt_event_handle_t event) {
+    if (event->total_data_len == event->data_len) {
+        mqtt_bridge_deliver(event->topic, event->topic_len,
+                            (const uint8_t *)event->data, event->data_len);
+        return;
+    }
+
+    // 只有第一个片段带主题
+    if (event->current_data_offset == 0) {
+        mqtt_bridge_begin(event->topic, event->topic_len, event->total_data_len);
+    }
+    if (mqtt_bridge_chunk((const uint8_t *)event->data, event->data_len,
+                          event->current_data_offset) == ESP_OK &&
+        event->current_data_offset + event->data_len >= event->total_data_len) {
+        mqtt_bridge_end(true);
+    }
+}
+
 // MQTT事件处理
 static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
     switch (event->event_id) {
@@ -43,6 +71,8 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
             ESP_LOGI(TAG, "MQTT Connected to broker");
             xEventGroupSetBits(network_event_group, MQTT_CONNECTED_BIT);
             current_status = NETWORK_STATUS_CONNECTED;
+            mqtt_bridge_foreach_filter(subscribe_bridge_filter, NULL);
+            offline_store_set_online(true);
             if (user_callback) {
                 user_callback(current_status, user_callback_data);
             }
@@ -52,6 +82,9 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
             ESP_LOGI(TAG, "MQTT Disconnected from broker");
             xEventGroupClearBits(network_event_group, MQTT_CONNECTED_BIT);
             current_status = NETWORK_STATUS_DISCONNECTED;
+            offline_store_set_online(false);
+            // 断开时丢弃未收完的分片消息
+            mqtt_bridge_end(false);
             if (user_callback) {
                 user_callback(current_status, user_callback_data);
             }
@@ -70,8 +103,8 @@ static esp_err_t mqtt_event_handler(esp_mqtt_event_handle_t event) {
             break;
             
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "MQTT Data received");
-            // 处理接收到的数据
+            // 本地队列满时在此阻塞, 由 MQTT 任务停止读取套接字形成背压
+            handle_mqtt_data(event);
             break;
             
         case MQTT_EVENT_ERROR:
@@ -168,4 +201,48 @@ esp_err_t network_init(const network_config_t *config) {
     }
 
     return ESP_OK;
-} 
\ No newline at end of file
+} 
+
+esp_err_t network_publish_direct(const char *topic, const uint8_t *data, size_t len,
+                                 uint8_t qos, bool retain) {
+    if (topic == NULL || (data == NULL && len > 0) || qos > 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mqtt_client == NULL ||
+        !(xEventGroupGetBits(network_event_group) & MQTT_CONNECTED_BIT)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // len 为 0 时 esp_mqtt 会对 data 取 strlen, 空载荷传空字符串
+    const char *payload = len > 0 ? (const char *)data : "";
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, payload, len, qos, retain);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "MQTT publish failed: %s", topic);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t network_publish(const char *topic, const uint8_t *data, size_t len,
+                          uint8_t qos, bool retain) {
+    // 积压补完之前新消息排在积压后面, 保持发布顺序
+    if (offline_store_pending() &&
+        offline_store_append(topic, data, len, qos, retain) == ESP_OK) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = network_publish_direct(topic, data, len, qos, retain);
+    if (err != ESP_ERR_INVALID_STATE && err != ESP_FAIL) {
+        return err;
+    }
+
+    // 发不出去的消息写入离线存储, 重连后补发
+    if (offline_store_append(topic, data, len, qos, retain) == ESP_OK) {
+        return ESP_OK;
+    }
+    return err;
+}
+
+esp_err_t network_send_message(const char *topic, const uint8_t *data, size_t len) {
+    return network_publish(topic, data, len, 0, false);
+}
@@ -3,6 +3,8 @@
 
 #include "esp_err.h"
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 // 网络配置结构体
 typedef struct {
@@ -31,7 +33,14 @@ esp_err_t network_init(const network_config_t *config);
 esp_err_t network_deinit(void);
 esp_err_t network_connect(void);
 esp_err_t network_disconnect(void);
+// 以 QoS 0 发布
 esp_err_t network_send_message(const char *topic, const uint8_t *data, size_t len);
+// 未连接或发送失败时写入离线存储 (已初始化时), 存储失败才返回错误
+esp_err_t network_publish(const char *topic, const uint8_t *data, size_t len,
+                          uint8_t qos, bool retain);
+// 不经过离线存储, 未连接到服务端时返回 ESP_ERR_INVALID_STATE
+esp_err_t network_publish_direct(const char *topic, const uint8_t *data, size_t len,
+                                 uint8_t qos, bool retain);
 esp_err_t network_register_callback(network_event_callback_t callback, void *user_data);
 network_status_t network_get_status(void);
 
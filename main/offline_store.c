@@ -0,0 +1,539 @@
+#include "offline_store.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stddef.h>
+#include <string.h>
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#else
+#include <stdio.h>
+#endif
+
+#define TAG "OFFLINE_STORE"
+#define OFFLINE_STORE_TASK_STACK_SIZE 4096
+#define OFFLINE_STORE_TASK_PRIORITY 4
+#define DEFAULT_DRAIN_RATE 20
+#define DEFAULT_FLUSH_INTERVAL_MS 1000
+#define DRAIN_RETRY_MS 1000
+#define MIN_SECTORS 2
+#define SEQ_ERASED 0xFFFFFFFF
+#define RECORD_ALIGN(len) (((len) + 3) & ~3u)   // 记录按 4 字节对齐写入
+
+// 记录头, 之后紧跟主题和载荷, 末尾以 0xFF 填充到对齐
+typedef struct __attribute__((packed)) {
+    uint32_t seq;
+    uint16_t payload_len;
+    uint8_t topic_len;
+    uint8_t flags;                 // bit0-1 QoS, bit2 retain
+    uint32_t crc;                  // 覆盖以上字段、主题和载荷
+} record_header_t;
+
+#define RECORD_CRC_LEN offsetof(record_header_t, crc)
+#define RECORD_MAX_BODY (OFFLINE_STORE_MAX_TOPIC + OFFLINE_STORE_MAX_PAYLOAD)
+
+static struct {
+    offline_store_config_t config;
+#ifdef ESP_PLATFORM
+    const esp_partition_t *partition;
+#else
+    FILE *file;
+#endif
+    uint32_t sector_count;
+    uint32_t head_sector;
+    uint32_t head_off;             // 下一条记录的写入位置, 包括写缓冲区中的记录
+    uint32_t tail_sector;
+    uint32_t tail_off;             // 最旧的未补发记录
+    uint32_t next_seq;
+    uint8_t wbuf[OFFLINE_STORE_WRITE_BUFFER];
+    uint32_t wbuf_len;
+    int64_t dirty_since_us;        // 写缓冲区中第一条记录加入的时间
+    uint8_t rbuf[RECORD_MAX_BODY]; // 只由补发任务和初始化使用
+    volatile bool online;
+    bool drain_now;                // 重新上线后立即开始补发, 由补发任务在锁内清除
+    int64_t drain_period_us;
+    offline_store_stats_t stats;
+    SemaphoreHandle_t lock;
+    TaskHandle_t task_handle;
+} store_ctx;
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t sector_addr(uint32_t sector, uint32_t off) {
+    return sector * OFFLINE_STORE_SECTOR_SIZE + off;
+}
+
+#ifdef ESP_PLATFORM
+static esp_err_t storage_open(void) {
+    store_ctx.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                   store_ctx.config.partition_label);
+    if (store_ctx.partition == NULL) {
+        ESP_LOGE(TAG, "Partition %s not found", store_ctx.config.partition_label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    store_ctx.sector_count = store_ctx.partition->size / OFFLINE_STORE_SECTOR_SIZE;
+    return ESP_OK;
+}
+
+static esp_err_t storage_read(uint32_t addr, void *buf, size_t len) {
+    return esp_partition_read(store_ctx.partition, addr, buf, len);
+}
+
+static esp_err_t storage_write(uint32_t addr, const void *buf, size_t len) {
+    return esp_partition_write(store_ctx.partition, addr, buf, len);
+}
+
+static esp_err_t storage_erase(uint32_t sector) {
+    return esp_partition_erase_range(store_ctx.partition, sector_addr(sector, 0),
+                                     OFFLINE_STORE_SECTOR_SIZE);
+}
+#else
+// 主机构建: 文件内容模拟擦除后为 0xFF 的闪存
+static esp_err_t storage_erase(uint32_t sector) {
+    static const uint8_t erased[256] = { [0 ... 255] = 0xFF };
+
+    if (fseek(store_ctx.file, sector_addr(sector, 0), SEEK_SET) != 0) {
+        return ESP_FAIL;
+    }
+    for (uint32_t i = 0; i < OFFLINE_STORE_SECTOR_SIZE; i += sizeof(erased)) {
+        if (fwrite(erased, 1, sizeof(erased), store_ctx.file) != sizeof(erased)) {
+            return ESP_FAIL;
+        }
+    }
+    return fflush(store_ctx.file) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t storage_open(void) {
+    store_ctx.file = fopen(store_ctx.config.path, "r+b");
+    if (store_ctx.file == NULL) {
+        store_ctx.file = fopen(store_ctx.config.path, "w+b");
+    }
+    if (store_ctx.file == NULL) {
+        ESP_LOGE(TAG, "Cannot open %s", store_ctx.config.path);
+        return ESP_ERR_NOT_FOUND;
+    }
+    store_ctx.sector_count = store_ctx.config.size_bytes / OFFLINE_STORE_SECTOR_SIZE;
+
+    // 新建或变大的文件补齐为已擦除的扇区
+    fseek(store_ctx.file, 0, SEEK_END);
+    long existing = ftell(store_ctx.file);
+    for (uint32_t s = existing / OFFLINE_STORE_SECTOR_SIZE; s < store_ctx.sector_count; s++) {
+        if (storage_erase(s) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t storage_read(uint32_t addr, void *buf, size_t len) {
+    if (fseek(store_ctx.file, addr, SEEK_SET) != 0 ||
+        fread(buf, 1, len, store_ctx.file) != len) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t storage_write(uint32_t addr, const void *buf, size_t len) {
+    if (fseek(store_ctx.file, addr, SEEK_SET) != 0 ||
+        fwrite(buf, 1, len, store_ctx.file) != len ||
+        fflush(store_ctx.file) != 0) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+#endif
+
+// 读出并校验一条记录, 返回 1 有效, 0 扇区在此结束 (已擦除), -1 损坏
+static int read_record(uint32_t sector, uint32_t off, record_header_t *header, uint8_t *body) {
+    if (off + sizeof(record_header_t) > OFFLINE_STORE_SECTOR_SIZE) {
+        return 0;
+    }
+    if (storage_read(sector_addr(sector, off), header, sizeof(record_header_t)) != ESP_OK) {
+        return -1;
+    }
+    if (header->seq == SEQ_ERASED) {
+        return 0;
+    }
+
+    uint32_t body_len = header->topic_len + header->payload_len;
+    if (header->topic_len == 0 || header->payload_len > OFFLINE_STORE_MAX_PAYLOAD ||
+        off + RECORD_ALIGN(sizeof(record_header_t) + body_len) > OFFLINE_STORE_SECTOR_SIZE) {
+        return -1;
+    }
+    if (storage_read(sector_addr(sector, off + sizeof(record_header_t)), body, body_len) != ESP_OK) {
+        return -1;
+    }
+
+    uint32_t crc = crc32_update(0, (const uint8_t *)header, RECORD_CRC_LEN);
+    crc = crc32_update(crc, body, body_len);
+    return crc == header->crc ? 1 : -1;
+}
+
+static uint32_t record_size(const record_header_t *header) {
+    return RECORD_ALIGN(sizeof(record_header_t) + header->topic_len + header->payload_len);
+}
+
+static bool store_empty(void) {
+    return store_ctx.tail_sector == store_ctx.head_sector &&
+           store_ctx.tail_off >= store_ctx.head_off;
+}
+
+// 启动时恢复读写位置: 首条记录序号最小的扇区是最旧的, 最大的是当前写入扇区
+static esp_err_t store_recover(void) {
+    record_header_t header;
+    uint32_t min_seq = UINT32_MAX;
+    uint32_t max_seq = 0;
+    int32_t tail = -1;
+    int32_t head = -1;
+
+    for (uint32_t s = 0; s < store_ctx.sector_count; s++) {
+        if (read_record(s, 0, &header, store_ctx.rbuf) != 1) {
+            continue;
+        }
+        if (header.seq < min_seq) {
+            min_seq = header.seq;
+            tail = s;
+        }
+        if (head < 0 || header.seq > max_seq) {
+            max_seq = header.seq;
+            head = s;
+        }
+    }
+
+    if (head < 0) {
+        store_ctx.head_sector = store_ctx.tail_sector = 0;
+        store_ctx.head_off = store_ctx.tail_off = 0;
+        store_ctx.next_seq = 0;
+        return storage_erase(0);
+    }
+
+    // 在写入扇区中找到最后一条有效记录之后的位置
+    uint32_t off = 0;
+    int ret;
+    while ((ret = read_record(head, off, &header, store_ctx.rbuf)) == 1) {
+        store_ctx.next_seq = header.seq + 1;
+        off += record_size(&header);
+    }
+    store_ctx.head_sector = head;
+    // 写入中断留下的残缺记录之后不能再写, 下一条记录换到新扇区
+    store_ctx.head_off = ret == 0 ? off : OFFLINE_STORE_SECTOR_SIZE;
+    store_ctx.tail_sector = tail;
+    store_ctx.tail_off = 0;
+    if (store_ctx.next_seq == SEQ_ERASED) {
+        store_ctx.next_seq = 0;
+    }
+    return ESP_OK;
+}
+
+// 写出写缓冲区, 调用者持有锁
+static esp_err_t flush_locked(void) {
+    if (store_ctx.wbuf_len == 0) {
+        return ESP_OK;
+    }
+
+    uint32_t addr = sector_addr(store_ctx.head_sector, store_ctx.head_off - store_ctx.wbuf_len);
+    esp_err_t err = storage_write(addr, store_ctx.wbuf, store_ctx.wbuf_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Write failed at 0x%x: %d", (unsigned)addr, err);
+    }
+    store_ctx.wbuf_len = 0;
+    return err;
+}
+
+// 写入位置移到下一个扇区, 环已满时覆盖最旧的扇区
+static void advance_head(void) {
+    uint32_t next = (store_ctx.head_sector + 1) % store_ctx.sector_count;
+
+    if (next == store_ctx.tail_sector) {
+        store_ctx.tail_sector = (store_ctx.tail_sector + 1) % store_ctx.sector_count;
+        store_ctx.tail_off = 0;
+        store_ctx.stats.dropped_sectors++;
+        ESP_LOGW(TAG, "Store full, dropping oldest sector");
+    }
+    if (storage_erase(next) != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of sector %u failed", (unsigned)next);
+    }
+    store_ctx.head_sector = next;
+    store_ctx.head_off = 0;
+}
+
+// 补发最旧的一条记录, 存储为空时返回 ESP_ERR_NOT_FOUND
+static esp_err_t drain_one(void) {
+    record_header_t header;
+    char topic[OFFLINE_STORE_MAX_TOPIC + 1];
+
+    xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+    while (1) {
+        if (store_empty()) {
+            xSemaphoreGive(store_ctx.lock);
+            return ESP_ERR_NOT_FOUND;
+        }
+        // 读到写缓冲区中的记录前先写出
+        if (store_ctx.tail_sector == store_ctx.head_sector &&
+            store_ctx.tail_off >= store_ctx.head_off - store_ctx.wbuf_len) {
+            flush_locked();
+        }
+
+        int ret = read_record(store_ctx.tail_sector, store_ctx.tail_off, &header, store_ctx.rbuf);
+        if (ret == 1) {
+            break;
+        }
+        if (ret < 0) {
+            store_ctx.stats.corrupt++;
+            ESP_LOGW(TAG, "Corrupt record in sector %u at %u, skipping rest of sector",
+                     (unsigned)store_ctx.tail_sector, (unsigned)store_ctx.tail_off);
+        }
+        if (store_ctx.tail_sector == store_ctx.head_sector) {
+            store_ctx.tail_off = store_ctx.head_off;
+            continue;
+        }
+        // 扇区已读完, 擦除后重启也不会重发
+        storage_erase(store_ctx.tail_sector);
+        store_ctx.tail_sector = (store_ctx.tail_sector + 1) % store_ctx.sector_count;
+        store_ctx.tail_off = 0;
+    }
+    uint32_t sector = store_ctx.tail_sector;
+    uint32_t off = store_ctx.tail_off;
+    xSemaphoreGive(store_ctx.lock);
+
+    // 发送时不持有锁, 追加不受影响
+    memcpy(topic, store_ctx.rbuf, header.topic_len);
+    topic[header.topic_len] = '\0';
+    esp_err_t err = store_ctx.config.send(topic, store_ctx.rbuf + header.topic_len, header.payload_len,
+                                          header.flags & 0x03, (header.flags & 0x04) != 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+    // 发送期间记录所在扇区可能已被覆盖
+    if (store_ctx.tail_sector == sector && store_ctx.tail_off == off) {
+        store_ctx.tail_off += record_size(&header);
+    }
+    store_ctx.stats.drained++;
+    xSemaphoreGive(store_ctx.lock);
+    return ESP_OK;
+}
+
+// 存储任务: 按时写出写缓冲区, 在线时按限速补发
+static void store_task(void *arg) {
+    int64_t flush_interval_us = (int64_t)store_ctx.config.flush_interval_ms * 1000;
+    int64_t next_drain_us = 0;     // 只由本任务读写
+
+    while (1) {
+        int64_t now_us = esp_timer_get_time();
+        int64_t wait_us = -1;
+
+        xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+        if (store_ctx.wbuf_len > 0) {
+            int64_t due_us = store_ctx.dirty_since_us + flush_interval_us;
+            if (now_us >= due_us) {
+                flush_locked();
+            } else {
+                wait_us = due_us - now_us;
+            }
+        }
+        bool pending = !store_empty();
+        if (store_ctx.drain_now) {
+            store_ctx.drain_now = false;
+            next_drain_us = 0;
+        }
+        xSemaphoreGive(store_ctx.lock);
+
+        if (store_ctx.online && pending) {
+            if (now_us >= next_drain_us) {
+                esp_err_t err = drain_one();
+                if (err == ESP_OK) {
+                    // 允许补上一个周期内因 tick 粒度积累的延迟, 但不突发
+                    int64_t base = next_drain_us > now_us - store_ctx.drain_period_us ?
+                                   next_drain_us : now_us;
+                    next_drain_us = base + store_ctx.drain_period_us;
+                } else if (err != ESP_ERR_NOT_FOUND) {
+                    next_drain_us = now_us + (int64_t)DRAIN_RETRY_MS * 1000;
+                }
+                continue;
+            }
+            int64_t drain_wait = next_drain_us - now_us;
+            if (wait_us < 0 || drain_wait < wait_us) {
+                wait_us = drain_wait;
+            }
+        }
+
+        TickType_t ticks = portMAX_DELAY;
+        if (wait_us >= 0) {
+            ticks = pdMS_TO_TICKS((wait_us + 999) / 1000);
+            if (ticks == 0) {
+                ticks = 1;
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+}
+
+esp_err_t offline_store_init(const offline_store_config_t *config) {
+    if (store_ctx.lock != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (config == NULL || config->send == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    store_ctx.config = *config;
+    if (store_ctx.config.drain_rate_per_sec == 0) {
+        store_ctx.config.drain_rate_per_sec = DEFAULT_DRAIN_RATE;
+    }
+    if (store_ctx.config.flush_interval_ms == 0) {
+        store_ctx.config.flush_interval_ms = DEFAULT_FLUSH_INTERVAL_MS;
+    }
+    store_ctx.drain_period_us = 1000000 / store_ctx.config.drain_rate_per_sec;
+
+    esp_err_t err = storage_open();
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (store_ctx.sector_count < MIN_SECTORS) {
+        ESP_LOGE(TAG, "Store needs at least %d sectors", MIN_SECTORS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    err = store_recover();
+    if (err != ESP_OK) {
+        return err;
+    }
+    store_ctx.stats.total_sectors = store_ctx.sector_count;
+
+    store_ctx.lock = xSemaphoreCreateMutex();
+    if (store_ctx.lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    BaseType_t ret = xTaskCreate(store_task, "offline_store", OFFLINE_STORE_TASK_STACK_SIZE, NULL,
+                                 OFFLINE_STORE_TASK_PRIORITY, &store_ctx.task_handle);
+    if (ret != pdPASS) {
+        vSemaphoreDelete(store_ctx.lock);
+        store_ctx.lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%u sectors, pending from sector %u to %u",
+             (unsigned)store_ctx.sector_count, (unsigned)store_ctx.tail_sector,
+             (unsigned)store_ctx.head_sector);
+    return ESP_OK;
+}
+
+esp_err_t offline_store_append(const char *topic, const uint8_t *data, size_t len,
+                               uint8_t qos, bool retain) {
+    if (store_ctx.lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (topic == NULL || (data == NULL && len > 0) || qos > 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t topic_len = strlen(topic);
+    if (topic_len == 0 || topic_len > OFFLINE_STORE_MAX_TOPIC || len > OFFLINE_STORE_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    record_header_t header = {
+        .payload_len = len,
+        .topic_len = topic_len,
+        .flags = qos | (retain ? 0x04 : 0)
+    };
+    uint32_t size = record_size(&header);
+
+    xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+    if (store_ctx.head_off + size > OFFLINE_STORE_SECTOR_SIZE) {
+        flush_locked();
+        advance_head();
+    }
+    if (store_ctx.wbuf_len + size > OFFLINE_STORE_WRITE_BUFFER) {
+        flush_locked();
+    }
+
+    header.seq = store_ctx.next_seq++;
+    if (store_ctx.next_seq == SEQ_ERASED) {
+        store_ctx.next_seq = 0;
+    }
+    uint32_t crc = crc32_update(0, (const uint8_t *)&header, RECORD_CRC_LEN);
+    crc = crc32_update(crc, (const uint8_t *)topic, topic_len);
+    header.crc = crc32_update(crc, data, len);
+
+    uint8_t *dst = store_ctx.wbuf + store_ctx.wbuf_len;
+    memcpy(dst, &header, sizeof(record_header_t));
+    memcpy(dst + sizeof(record_header_t), topic, topic_len);
+    if (len > 0) {
+        memcpy(dst + sizeof(record_header_t) + topic_len, data, len);
+    }
+    uint32_t used = sizeof(record_header_t) + topic_len + len;
+    memset(dst + used, 0xFF, size - used);
+
+    if (store_ctx.wbuf_len == 0) {
+        store_ctx.dirty_since_us = esp_timer_get_time();
+    }
+    store_ctx.wbuf_len += size;
+    store_ctx.head_off += size;
+    store_ctx.stats.stored++;
+    xSemaphoreGive(store_ctx.lock);
+
+    xTaskNotifyGive(store_ctx.task_handle);
+    return ESP_OK;
+}
+
+esp_err_t offline_store_flush(void) {
+    if (store_ctx.lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+    esp_err_t err = flush_locked();
+    xSemaphoreGive(store_ctx.lock);
+    return err;
+}
+
+void offline_store_set_online(bool online) {
+    if (store_ctx.lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+    store_ctx.online = online;
+    if (online) {
+        store_ctx.drain_now = true;
+    }
+    xSemaphoreGive(store_ctx.lock);
+    xTaskNotifyGive(store_ctx.task_handle);
+}
+
+bool offline_store_pending(void) {
+    if (store_ctx.lock == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+    bool pending = !store_empty();
+    xSemaphoreGive(store_ctx.lock);
+    return pending;
+}
+
+void offline_store_get_stats(offline_store_stats_t *stats) {
+    if (store_ctx.lock == NULL) {
+        memset(stats, 0, sizeof(offline_store_stats_t));
+        return;
+    }
+
+    xSemaphoreTake(store_ctx.lock, portMAX_DELAY);
+    *stats = store_ctx.stats;
+    stats->used_sectors = store_empty() ? 0 :
+        (store_ctx.head_sector + store_ctx.sector_count - store_ctx.tail_sector) %
+        store_ctx.sector_count + 1;
+    xSemaphoreGive(store_ctx.lock);
+}
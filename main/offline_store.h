@@ -0,0 +1,59 @@
+#ifndef OFFLINE_STORE_H
+#define OFFLINE_STORE_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 离线存储转发: 未连接时上行消息追加到日志结构的环形存储, 重连后按限速补发
+// ESP32 上使用数据分区, Linux 主机构建使用普通文件
+// 存储按扇区组成环: 记录顺序追加, 不跨扇区, 先攒在写缓冲区再整块顺序写入以减少磨损;
+// 写满时擦除并覆盖最旧的扇区. 每条记录带序号和 CRC32, 启动时扫描扇区恢复读写位置,
+// 损坏的记录连同所在扇区的剩余部分被跳过
+// 补发完一个扇区后才擦除它, 重启后最多重发一个扇区内已发送的记录 (至少一次)
+
+#define OFFLINE_STORE_SECTOR_SIZE   4096
+#define OFFLINE_STORE_WRITE_BUFFER  2048
+#define OFFLINE_STORE_MAX_TOPIC     255
+#define OFFLINE_STORE_MAX_PAYLOAD   1024
+
+// 补发使用的发布函数, 不能再写回离线存储
+typedef esp_err_t (*offline_store_send_t)(const char *topic, const uint8_t *data, size_t len,
+                                          uint8_t qos, bool retain);
+
+typedef struct {
+#ifdef ESP_PLATFORM
+    const char *partition_label;   // 数据分区标签
+#else
+    const char *path;              // 存储文件路径
+    uint32_t size_bytes;           // 文件大小, 向下取整到扇区
+#endif
+    offline_store_send_t send;
+    uint32_t drain_rate_per_sec;   // 重连后每秒补发的消息数, 0 使用默认值
+    uint32_t flush_interval_ms;    // 写缓冲区最长停留时间, 0 使用默认值
+} offline_store_config_t;
+
+typedef struct {
+    uint32_t stored;
+    uint32_t drained;
+    uint32_t dropped_sectors;      // 存储写满时被覆盖的扇区数
+    uint32_t corrupt;              // CRC 校验失败的记录数
+    uint32_t used_sectors;
+    uint32_t total_sectors;
+} offline_store_stats_t;
+
+// 离线存储API
+esp_err_t offline_store_init(const offline_store_config_t *config);
+// 未初始化时返回 ESP_ERR_INVALID_STATE
+esp_err_t offline_store_append(const char *topic, const uint8_t *data, size_t len,
+                               uint8_t qos, bool retain);
+// 立即写出写缓冲区
+esp_err_t offline_store_flush(void);
+// 连接建立后置为 true 开始补发, 断开时置为 false
+void offline_store_set_online(bool online);
+// 存储中还有未补发的记录; 此时新消息也应追加到存储, 否则会越过积压的旧消息先发出
+bool offline_store_pending(void);
+void offline_store_get_stats(offline_store_stats_t *stats);
+
+#endif /* OFFLINE_STORE_H */
@@ -1,11 +1,17 @@
 #include "pubsub_core.h"
 #include "memory_pool.h"
+#include "memory_budget.h"
 #include "esp_log.h"
 #include <string.h>
 
 #define TAG "PUBLISHER"
 
 pubsub_err_t pubsub_publish(const char *topic_name, const uint8_t *data, uint32_t data_len, msg_priority_t priority) {
+    return pubsub_publish_with_id(topic_name, data, data_len, priority, 0);
+}
+
+pubsub_err_t pubsub_publish_with_id(const char *topic_name, const uint8_t *data, uint32_t data_len,
+                                    msg_priority_t priority, uint32_t msg_id) {
     if (topic_name == NULL || (data == NULL && data_len > 0)) {
         return PUBSUB_ERR_INVALID_PARAM;
     }
@@ -26,6 +32,15 @@ pubsub_err_t pubsub_publish(const char *topic_name, const uint8_t *data, uint32_
         return PUBSUB_ERR_TOPIC_NOT_FOUND;
     }
 
+    // 按优先级做内存预算准入
+    uint32_t topic_index = topic - topics;
+    if (!memory_budget_admit(topic_index, data_len, priority)) {
+        xSemaphoreGive(topics_lock);
+        ESP_LOGW(TAG, "Message shed on topic: %s, size: %d bytes, priority: %d",
+                 topic_name, data_len, priority);
+        return PUBSUB_ERR_OVER_BUDGET;
+    }
+
     // 创建消息
     pubsub_msg_t msg;
     memset(&msg, 0, sizeof(pubsub_msg_t));
@@ -36,6 +51,7 @@ pubsub_err_t pubsub_publish(const char *topic_name, const uint8_t *data, uint32_
     if (data_len > 0) {
         msg.data = memory_pool_alloc(data_len);
         if (msg.data == NULL) {
+            memory_budget_release(topic_index, data_len);
             xSemaphoreGive(topics_lock);
             return PUBSUB_ERR_NO_MEMORY;
         }
@@ -46,6 +62,7 @@ pubsub_err_t pubsub_publish(const char *topic_name, const uint8_t *data, uint32_
     
     msg.data_len = data_len;
     msg.priority = priority;
+    msg.msg_id = msg_id;
     msg.timestamp = esp_timer_get_time();
 
     // 发送消息到队列
@@ -60,6 +77,7 @@ pubsub_err_t pubsub_publish(const char *topic_name, const uint8_t *data, uint32_
         if (msg.data != NULL) {
             memory_pool_free(msg.data);
         }
+        memory_budget_release(topic_index, data_len);
         xSemaphoreGive(topics_lock);
         return PUBSUB_ERR_QUEUE_FULL;
     }
@@ -67,4 +85,68 @@ pubsub_err_t pubsub_publish(const char *topic_name, const uint8_t *data, uint32_
     xSemaphoreGive(topics_lock);
     ESP_LOGI(TAG, "Message published to topic: %s, size: %d bytes", topic_name, data_len);
     return PUBSUB_OK;
-} 
\ No newline at end of file
+} 
+
+pubsub_err_t pubsub_publish_owned(const char *topic_name, uint8_t *data, uint32_t data_len,
+                                  msg_priority_t priority, TickType_t wait_ticks) {
+    return pubsub_publish_owned_with_id(topic_name, data, data_len, priority, 0, wait_ticks);
+}
+
+pubsub_err_t pubsub_publish_owned_with_id(const char *topic_name, uint8_t *data, uint32_t data_len,
+                                          msg_priority_t priority, uint32_t msg_id,
+                                          TickType_t wait_ticks) {
+    if (topic_name == NULL || (data == NULL && data_len > 0)) {
+        return PUBSUB_ERR_INVALID_PARAM;
+    }
+
+    xSemaphoreTake(topics_lock, portMAX_DELAY);
+
+    // 查找主题
+    topic_t *topic = NULL;
+    for (uint32_t i = 0; i < topic_count; i++) {
+        if (strcmp(topics[i].name, topic_name) == 0) {
+            topic = &topics[i];
+            break;
+        }
+    }
+
+    if (topic == NULL) {
+        xSemaphoreGive(topics_lock);
+        return PUBSUB_ERR_TOPIC_NOT_FOUND;
+    }
+
+    uint32_t topic_index = topic - topics;
+    if (!memory_budget_admit(topic_index, data_len, priority)) {
+        xSemaphoreGive(topics_lock);
+        ESP_LOGW(TAG, "Message shed on topic: %s, size: %d bytes, priority: %d",
+                 topic_name, data_len, priority);
+        return PUBSUB_ERR_OVER_BUDGET;
+    }
+
+    // 主题只增不删, 队列句柄在释放锁后仍然有效; 等待队列空间时不持有全局锁
+    QueueHandle_t queue = topic->msg_queue;
+    xSemaphoreGive(topics_lock);
+
+    pubsub_msg_t msg;
+    memset(&msg, 0, sizeof(pubsub_msg_t));
+    strncpy(msg.topic, topic_name, MAX_TOPIC_NAME_LENGTH - 1);
+    msg.topic[MAX_TOPIC_NAME_LENGTH - 1] = '\0';
+    msg.data = data_len > 0 ? data : NULL;
+    msg.data_len = data_len;
+    msg.priority = priority;
+    msg.msg_id = msg_id;
+    msg.timestamp = esp_timer_get_time();
+
+    BaseType_t result;
+    if (priority == MSG_PRIORITY_CRITICAL) {
+        result = xQueueSendToFront(queue, &msg, wait_ticks);
+    } else {
+        result = xQueueSend(queue, &msg, wait_ticks);
+    }
+
+    if (result != pdTRUE) {
+        memory_budget_release(topic_index, data_len);
+        return PUBSUB_ERR_QUEUE_FULL;
+    }
+    return PUBSUB_OK;
+}
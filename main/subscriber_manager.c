@@ -26,6 +26,9 @@ pubsub_err_t pubsub_subscribe(const char *topic_name, subscriber_callback_t call
         return PUBSUB_ERR_TOPIC_NOT_FOUND;
     }
 
+    // 主题只增不删, 释放全局锁后主题仍然有效. 订阅者回调在持有主题锁时可能发布消息
+    // (获取 topics_lock), 因此不能持有 topics_lock 再等待主题锁
+    xSemaphoreGive(topics_lock);
     xSemaphoreTake(topic->lock, portMAX_DELAY);
 
     // 检查是否已经订阅
@@ -33,7 +36,6 @@ pubsub_err_t pubsub_subscribe(const char *topic_name, subscriber_callback_t call
     while (current != NULL) {
         if (current->callback == callback) {
             xSemaphoreGive(topic->lock);
-            xSemaphoreGive(topics_lock);
             return PUBSUB_ERR_INVALID_PARAM;
         }
         current = current->next;
@@ -42,15 +44,13 @@ pubsub_err_t pubsub_subscribe(const char *topic_name, subscriber_callback_t call
     // 检查订阅者数量限制
     if (topic->subscriber_count >= MAX_SUBSCRIBERS_PER_TOPIC) {
         xSemaphoreGive(topic->lock);
-        xSemaphoreGive(topics_lock);
         return PUBSUB_ERR_MAX_SUBSCRIBERS;
     }
 
     // 创建新订阅者
-    subscriber_t *new_subscriber = (subscriber_t *)memory_pool_alloc(sizeof(subscriber_t));
+    subscriber_t *new_subscriber = subscriber_pool_alloc();
     if (new_subscriber == NULL) {
         xSemaphoreGive(topic->lock);
-        xSemaphoreGive(topics_lock);
         return PUBSUB_ERR_NO_MEMORY;
     }
 
@@ -61,7 +61,6 @@ pubsub_err_t pubsub_subscribe(const char *topic_name, subscriber_callback_t call
     topic->subscriber_count++;
 
     xSemaphoreGive(topic->lock);
-    xSemaphoreGive(topics_lock);
     
     ESP_LOGI(TAG, "New subscriber added to topic: %s", topic_name);
     return PUBSUB_OK;
@@ -88,6 +87,8 @@ pubsub_err_t pubsub_unsubscribe(const char *topic_name, subscriber_callback_t ca
         return PUBSUB_ERR_TOPIC_NOT_FOUND;
     }
 
+    // 同 pubsub_subscribe, 不持有 topics_lock 等待主题锁
+    xSemaphoreGive(topics_lock);
     xSemaphoreTake(topic->lock, portMAX_DELAY);
 
     subscriber_t *current = topic->subscribers;
@@ -100,11 +101,10 @@ pubsub_err_t pubsub_unsubscribe(const char *topic_name, subscriber_callback_t ca
             } else {
                 prev->next = current->next;
             }
-            memory_pool_free(current);
+            subscriber_pool_free(current);
             topic->subscriber_count--;
             
             xSemaphoreGive(topic->lock);
-            xSemaphoreGive(topics_lock);
             
             ESP_LOGI(TAG, "Subscriber removed from topic: %s", topic_name);
             return PUBSUB_OK;
@@ -114,6 +114,5 @@ pubsub_err_t pubsub_unsubscribe(const char *topic_name, subscriber_callback_t ca
     }
 
     xSemaphoreGive(topic->lock);
-    xSemaphoreGive(topics_lock);
     return PUBSUB_ERR_INVALID_PARAM;
 } 
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "timer_wheel.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+#define TAG "TIMER_WHEEL"
+#define TIMER_WHEEL_TASK_STACK_SIZE 4096
+#define TIMER_WHEEL_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+
+#define L0_BITS 8
+#define L1_BITS 6
+#define L0_SIZE (1u << L0_BITS)
+#define L1_SIZE (1u << L1_BITS)
+#define L0_MASK (L0_SIZE - 1)
+#define L1_MASK (L1_SIZE - 1)
+#define WHEEL_RANGE (L0_SIZE * L1_SIZE)
+
+static struct {
+    timer_wheel_timer_t *level0[L0_SIZE];
+    timer_wheel_timer_t *level1[L1_SIZE];
+    uint32_t current_tick;              // 最后一个已处理的 tick
+    uint32_t tick_ms;
+    timer_wheel_stats_t stats;
+    const timer_wheel_timer_t *running; // 正在锁外执行回调的定时器
+    TaskHandle_t task_handle;
+    portMUX_TYPE mux;
+} wheel_ctx = { .mux = portMUX_INITIALIZER_UNLOCKED };
+
+static void list_add(timer_wheel_timer_t **head, timer_wheel_timer_t *timer) {
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void list_del(timer_wheel_timer_t *timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// 根据到期时间放入对应层级的槽, 调用者需持有锁
+static void wheel_insert(timer_wheel_timer_t *timer) {
+    int32_t delta = (int32_t)(timer->expires - wheel_ctx.current_tick);
+    if (delta <= 0) {
+        timer->expires = wheel_ctx.current_tick + 1;
+        delta = 1;
+    }
+
+    if ((uint32_t)delta < L0_SIZE) {
+        list_add(&wheel_ctx.level0[timer->expires & L0_MASK], timer);
+    } else if ((uint32_t)delta < WHEEL_RANGE) {
+        list_add(&wheel_ctx.level1[(timer->expires >> L0_BITS) & L1_MASK], timer);
+    } else {
+        uint32_t horizon = wheel_ctx.current_tick + WHEEL_RANGE - 1;
+        list_add(&wheel_ctx.level1[(horizon >> L0_BITS) & L1_MASK], timer);
+    }
+}
+
+// 将第1层当前槽的定时器下放到第0层, 调用者需持有锁
+static void wheel_cascade(void) {
+    uint32_t idx = (wheel_ctx.current_tick >> L0_BITS) & L1_MASK;
+    timer_wheel_timer_t *timer = wheel_ctx.level1[idx];
+    wheel_ctx.level1[idx] = NULL;
+
+    while (timer != NULL) {
+        timer_wheel_timer_t *next = timer->next;
+        timer->pprev = NULL;
+        timer->next = NULL;
+        if (timer->expires == wheel_ctx.current_tick) {
+            // 恰好在本 tick 到期, 放入当前槽, 随后的处理循环会触发它
+            list_add(&wheel_ctx.level0[timer->expires & L0_MASK], timer);
+        } else {
+            wheel_insert(timer);
+        }
+        wheel_ctx.stats.cascade_count++;
+        timer = next;
+    }
+}
+
+static void record_lateness(int64_t expected_us) {
+    int64_t late = esp_timer_get_time() - expected_us;
+    uint32_t sample = late > 0 ? (uint32_t)late : 0;
+    if (sample > wheel_ctx.stats.max_lateness_us) {
+        wheel_ctx.stats.max_lateness_us = sample;
+    }
+    int32_t diff = (int32_t)sample - (int32_t)wheel_ctx.stats.avg_lateness_us;
+    wheel_ctx.stats.avg_lateness_us += diff / 8;
+}
+
+static void timer_wheel_process_tick(void) {
+    portENTER_CRITICAL(&wheel_ctx.mux);
+    wheel_ctx.current_tick++;
+    if ((wheel_ctx.current_tick & L0_MASK) == 0) {
+        wheel_cascade();
+    }
+
+    // 每次只摘下一个定时器并在锁外执行回调, 回调中可安全地启动或停止任意定时器
+    timer_wheel_timer_t **slot = &wheel_ctx.level0[wheel_ctx.current_tick & L0_MASK];
+    while (*slot != NULL) {
+        timer_wheel_timer_t *timer = *slot;
+        list_del(timer);
+
+        timer_wheel_callback_t callback = timer->callback;
+        void *arg = timer->arg;
+        record_lateness(timer->expected_us);
+        wheel_ctx.stats.fired_count++;
+
+        if (timer->period_ticks > 0) {
+            timer->expires = wheel_ctx.current_tick + timer->period_ticks;
+            timer->expected_us += (int64_t)timer->period_ticks * wheel_ctx.tick_ms * 1000;
+            wheel_insert(timer);
+        } else {
+            wheel_ctx.stats.active_timers--;
+        }
+
+        wheel_ctx.running = timer;
+        portEXIT_CRITICAL(&wheel_ctx.mux);
+        if (callback) {
+            callback(arg);
+        }
+        portENTER_CRITICAL(&wheel_ctx.mux);
+        wheel_ctx.running = NULL;
+    }
+    portEXIT_CRITICAL(&wheel_ctx.mux);
+}
+
+static void timer_wheel_task(void *pvParameters) {
+    TickType_t last_wake = xTaskGetTickCount();
+    const TickType_t period = pdMS_TO_TICKS(wheel_ctx.tick_ms) ? pdMS_TO_TICKS(wheel_ctx.tick_ms) : 1;
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, period);
+        timer_wheel_process_tick();
+    }
+}
+
+esp_err_t timer_wheel_init(uint32_t tick_ms) {
+    if (tick_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (wheel_ctx.task_handle != NULL) {
+        return ESP_OK; // 已经初始化
+    }
+
+    memset(wheel_ctx.level0, 0, sizeof(wheel_ctx.level0));
+    memset(wheel_ctx.level1, 0, sizeof(wheel_ctx.level1));
+    memset(&wheel_ctx.stats, 0, sizeof(timer_wheel_stats_t));
+    wheel_ctx.current_tick = 0;
+    wheel_ctx.tick_ms = tick_ms;
+
+    BaseType_t ret = xTaskCreate(timer_wheel_task, "timer_wheel",
+                                TIMER_WHEEL_TASK_STACK_SIZE, NULL,
+                                TIMER_WHEEL_TASK_PRIORITY, &wheel_ctx.task_handle);
+    if (ret != pdPASS) {
+        wheel_ctx.task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Timer wheel started, tick %u ms", tick_ms);
+    return ESP_OK;
+}
+
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, timer_wheel_callback_t callback, void *arg) {
+    memset(timer, 0, sizeof(timer_wheel_timer_t));
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+esp_err_t timer_wheel_start(timer_wheel_timer_t *timer, uint32_t delay_ms, uint32_t period_ms) {
+    if (timer == NULL || wheel_ctx.task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t delay_ticks = (delay_ms + wheel_ctx.tick_ms - 1) / wheel_ctx.tick_ms;
+    uint32_t period_ticks = (period_ms + wheel_ctx.tick_ms - 1) / wheel_ctx.tick_ms;
+
+    portENTER_CRITICAL(&wheel_ctx.mux);
+    if (timer->pprev != NULL) {
+        list_del(timer);
+    } else {
+        if (++wheel_ctx.stats.active_timers > wheel_ctx.stats.peak_timers) {
+            wheel_ctx.stats.peak_timers = wheel_ctx.stats.active_timers;
+        }
+    }
+    timer->expires = wheel_ctx.current_tick + (delay_ticks ? delay_ticks : 1);
+    timer->period_ticks = period_ticks;
+    timer->expected_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    wheel_insert(timer);
+    portEXIT_CRITICAL(&wheel_ctx.mux);
+
+    return ESP_OK;
+}
+
+void timer_wheel_stop(timer_wheel_timer_t *timer) {
+    if (timer == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&wheel_ctx.mux);
+    if (timer->pprev != NULL) {
+        list_del(timer);
+        wheel_ctx.stats.active_timers--;
+    }
+    timer->period_ticks = 0;
+    portEXIT_CRITICAL(&wheel_ctx.mux);
+}
+
+void timer_wheel_stop_sync(timer_wheel_timer_t *timer) {
+    if (timer == NULL) {
+        return;
+    }
+
+    // 在时间轮任务中调用时等待会死锁, 退化为普通停止
+    bool in_wheel_task = xTaskGetCurrentTaskHandle() == wheel_ctx.task_handle;
+    while (1) {
+        portENTER_CRITICAL(&wheel_ctx.mux);
+        if (timer->pprev != NULL) {
+            list_del(timer);
+            wheel_ctx.stats.active_timers--;
+        }
+        timer->period_ticks = 0;
+        bool running = wheel_ctx.running == timer;
+        portEXIT_CRITICAL(&wheel_ctx.mux);
+
+        if (!running || in_wheel_task) {
+            return;
+        }
+        vTaskDelay(1);
+    }
+}
+
+bool timer_wheel_is_active(const timer_wheel_timer_t *timer) {
+    return timer != NULL && timer->pprev != NULL;
+}
+
+uint32_t timer_wheel_get_tick_ms(void) {
+    return wheel_ctx.tick_ms;
+}
+
+void timer_wheel_get_stats(timer_wheel_stats_t *stats) {
+    if (stats == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&wheel_ctx.mux);
+    memcpy(stats, &wheel_ctx.stats, sizeof(timer_wheel_stats_t));
+    portEXIT_CRITICAL(&wheel_ctx.mux);
+}
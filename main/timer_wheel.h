@@ -0,0 +1,49 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// 共享的分层时间轮: 单个 tick 任务驱动所有软件定时器
+// 第0层 256 个槽, 每槽 1 tick; 第1层 64 个槽, 每槽 256 tick
+// 超出两层范围的定时器放在第1层最远的槽, 级联时重新计算位置
+#define TIMER_WHEEL_DEFAULT_TICK_MS 10
+
+// 定时器回调, 在时间轮任务上下文中执行, 不应长时间阻塞
+typedef void (*timer_wheel_callback_t)(void *arg);
+
+// 定时器节点, 由使用者嵌入自己的结构体中, 时间轮本身不分配内存
+typedef struct timer_wheel_timer {
+    struct timer_wheel_timer *next;
+    struct timer_wheel_timer **pprev;   // 指向前驱的 next 指针, 用于 O(1) 摘除
+    uint32_t expires;                   // 到期 tick
+    uint32_t period_ticks;              // 0 表示单次定时器
+    int64_t expected_us;                // 预期触发时间, 用于统计延迟
+    timer_wheel_callback_t callback;
+    void *arg;
+} timer_wheel_timer_t;
+
+// 时间轮统计信息
+typedef struct {
+    uint32_t active_timers;
+    uint32_t peak_timers;
+    uint32_t fired_count;
+    uint32_t cascade_count;
+    uint32_t max_lateness_us;           // 最大触发延迟
+    uint32_t avg_lateness_us;           // 触发延迟的指数移动平均
+} timer_wheel_stats_t;
+
+// 时间轮API
+esp_err_t timer_wheel_init(uint32_t tick_ms);
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, timer_wheel_callback_t callback, void *arg);
+esp_err_t timer_wheel_start(timer_wheel_timer_t *timer, uint32_t delay_ms, uint32_t period_ms);
+void timer_wheel_stop(timer_wheel_timer_t *timer);
+// 停止并等待正在执行的回调返回, 之后可以释放定时器所在的结构体
+// 不能在该定时器自己的回调中调用
+void timer_wheel_stop_sync(timer_wheel_timer_t *timer);
+bool timer_wheel_is_active(const timer_wheel_timer_t *timer);
+uint32_t timer_wheel_get_tick_ms(void);
+void timer_wheel_get_stats(timer_wheel_stats_t *stats);
+
+#endif /* TIMER_WHEEL_H */
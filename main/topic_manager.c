@@ -1,5 +1,8 @@
 #include "pubsub_core.h"
 #include "memory_pool.h"
+#include "object_pool.h"
+#include "memory_budget.h"
+#include "dedup_window.h"
 #include <string.h>
 
 typedef struct subscriber {
@@ -8,12 +11,17 @@ typedef struct subscriber {
     struct subscriber *next;
 } subscriber_t;
 
+// 订阅者元数据使用独立的定长对象池, 避免与消息载荷争用字节池
+OBJECT_POOL_DEFINE(subscriber_pool, subscriber_t, MAX_SUBSCRIBERS_TOTAL)
+
 typedef struct topic {
     char name[MAX_TOPIC_NAME_LENGTH];
     subscriber_t *subscribers;
     QueueHandle_t msg_queue;
     uint32_t subscriber_count;
     SemaphoreHandle_t lock;
+    bool dedup_enabled;            // 恰好一次主题在分发前按 msg_id 去重
+    dedup_window_t dedup;
 } topic_t;
 
 static topic_t topics[MAX_TOPICS];
@@ -27,8 +35,14 @@ static void topic_task(void *pvParameters) {
     while (1) {
         if (xQueueReceive(topic->msg_queue, &msg, portMAX_DELAY) == pdTRUE) {
             xSemaphoreTake(topic->lock, portMAX_DELAY);
-            
-            subscriber_t *current = topic->subscribers;
+
+            // 重传产生的重复消息不再分发给订阅者
+            bool deliver = true;
+            if (topic->dedup_enabled && msg.msg_id != 0) {
+                deliver = dedup_window_check_and_set(&topic->dedup, msg.msg_id);
+            }
+
+            subscriber_t *current = deliver ? topic->subscribers : NULL;
             while (current != NULL) {
                 current->callback(&msg, current->user_data);
                 current = current->next;
@@ -38,6 +52,7 @@ static void topic_task(void *pvParameters) {
             if (msg.data != NULL) {
                 memory_pool_free(msg.data);
             }
+            memory_budget_release(topic - topics, msg.data_len);
 
             xSemaphoreGive(topic->lock);
         }
@@ -55,6 +70,8 @@ pubsub_err_t pubsub_init(void) {
     }
 
     memset(topics, 0, sizeof(topics));
+    subscriber_pool_init();
+    memory_budget_init(NULL);
     return PUBSUB_OK;
 }
 
@@ -97,6 +114,8 @@ pubsub_err_t pubsub_create_topic(const char *topic_name) {
 
     topic->subscribers = NULL;
     topic->subscriber_count = 0;
+    topic->dedup_enabled = false;
+    dedup_window_init(&topic->dedup);
 
     // 创建主题处理任务
     char task_name[32];
@@ -115,6 +134,42 @@ pubsub_err_t pubsub_create_topic(const char *topic_name) {
     return PUBSUB_OK;
 }
 
+int pubsub_get_topic_index(const char *topic_name) {
+    if (topic_name == NULL) {
+        return -1;
+    }
+
+    int index = -1;
+    xSemaphoreTake(topics_lock, portMAX_DELAY);
+    for (uint32_t i = 0; i < topic_count; i++) {
+        if (strcmp(topics[i].name, topic_name) == 0) {
+            index = i;
+            break;
+        }
+    }
+    xSemaphoreGive(topics_lock);
+    return index;
+}
+
+pubsub_err_t pubsub_set_topic_dedup(const char *topic_name, bool enable) {
+    if (topic_name == NULL) {
+        return PUBSUB_ERR_INVALID_PARAM;
+    }
+
+    int index = pubsub_get_topic_index(topic_name);
+    if (index < 0) {
+        return PUBSUB_ERR_TOPIC_NOT_FOUND;
+    }
+
+    // 不持有 topics_lock 等待主题锁, 见 pubsub_subscribe
+    topic_t *topic = &topics[index];
+    xSemaphoreTake(topic->lock, portMAX_DELAY);
+    topic->dedup_enabled = enable;
+    dedup_window_init(&topic->dedup);
+    xSemaphoreGive(topic->lock);
+    return PUBSUB_OK;
+}
+
 这只是项目的一部分代码。由于回答长度限制，我将分几个部分继续提供其他模块的实现，包括：
 
 1. 订阅者管理的实现
@@ -1,5 +1,6 @@
 #include "topic_manager_advanced.h"
 #include "memory_pool.h"
+#include "memory_budget.h"
 #include "error_handler.h"
 #include "esp_log.h"
 #include <string.h>
@@ -91,7 +92,16 @@ esp_err_t topic_create_with_config(const char *topic_name, const topic_config_t
     xSemaphoreGive(topic_advanced_data[slot].stats_lock);
 
     // 创建基本主题
-    return pubsub_create_topic(topic_name);
+    esp_err_t ret = pubsub_create_topic(topic_name);
+    if (ret != PUBSUB_OK) {
+        return ret;
+    }
+
+    // 恰好一次主题启用滑动窗口去重
+    if (config->qos_level == TOPIC_QOS_EXACTLY_ONCE) {
+        ret = pubsub_set_topic_dedup(topic_name, true);
+    }
+    return ret;
 }
 
 esp_err_t topic_delete_with_cleanup(const char *topic_name) {
@@ -156,5 +166,31 @@ esp_err_t topic_get_stats(const char *topic_name, topic_stats_t *stats) {
     memcpy(stats, &topic_advanced_data[slot].stats, sizeof(topic_stats_t));
     xSemaphoreGive(topic_advanced_data[slot].stats_lock);
 
+    // 合并内存预算统计
+    memory_budget_topic_stats_t budget;
+    if (memory_budget_get_topic_stats(slot, &budget) == ESP_OK) {
+        stats->msg_shed = 0;
+        for (int i = 0; i <= MSG_PRIORITY_CRITICAL; i++) {
+            stats->msg_shed += budget.shed_count[i];
+        }
+        stats->memory_used = budget.used_bytes;
+    }
+    stats->msg_duplicates = topics[slot].dedup.duplicates;
+    stats->msg_stale = topics[slot].dedup.stale;
+
     return ESP_OK;
+}
+
+esp_err_t topic_set_memory_limit(const char *topic_name, size_t limit_bytes) {
+    if (topic_name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < MAX_TOPICS; i++) {
+        if (strcmp(topics[i].name, topic_name) == 0) {
+            return memory_budget_set_topic_limit(i, limit_bytes);
+        }
+    }
+
+    return ESP_ERR_NOT_FOUND;
 } 
\ No newline at end of file
@@ -12,6 +12,10 @@ typedef struct {
     uint32_t subscriber_count;
     uint64_t last_msg_timestamp;
     uint32_t queue_space_available;
+    uint32_t msg_shed;             // 因内存预算被丢弃的消息数
+    uint32_t memory_used;          // 当前占用的预算字节数
+    uint32_t msg_duplicates;       // 去重窗口丢弃的重复消息数
+    uint32_t msg_stale;            // 早于去重窗口、未经判断直接分发的消息数
 } topic_stats_t;
 
 // 主题过滤器
@@ -45,5 +49,6 @@ esp_err_t topic_set_filter(const topic_filter_t *filter);
 esp_err_t topic_clear_filter(void);
 esp_err_t topic_flush_messages(const char *topic_name);
 esp_err_t topic_get_retained_message(const char *topic_name, pubsub_msg_t *msg);
+esp_err_t topic_set_memory_limit(const char *topic_name, size_t limit_bytes);
 
 #endif /* TOPIC_MANAGER_ADVANCED_H */ 
\ No newline at end of file